@@ -0,0 +1,274 @@
+#include "astrometry.h"
+#include "timebase.h"
+#include <cmath>
+
+static const double arcsec = M_PI / (180.0 * 3600);
+static const double degree = M_PI / 180;
+
+// UTC Unix epoch as Julian date, TT - UTC since 2017
+static const double jd_unix = 2440587.5;
+static const double tt_utc = 69.184;
+
+// altitude range of refraction tables, degrees
+static const double refraction_min = -1;
+static const double refraction_step = 0.05;
+
+struct NutationTerm
+{
+    int d, m, mp, f, om;
+    double psi, psi_t, eps, eps_t;
+};
+
+// 0.0001 arcsec
+static const NutationTerm nutation_terms[] = {
+    { 0,  0,  0, 0, 1, -171996, -174.2, 92025,  8.9},
+    {-2,  0,  0, 2, 2,  -13187,   -1.6,  5736, -3.1},
+    { 0,  0,  0, 2, 2,   -2274,   -0.2,   977, -0.5},
+    { 0,  0,  0, 0, 2,    2062,    0.2,  -895,  0.5},
+    { 0,  1,  0, 0, 0,    1426,   -3.4,    54, -0.1},
+    { 0,  0,  1, 0, 0,     712,    0.1,    -7,  0.0},
+    {-2,  1,  0, 2, 2,    -517,    1.2,   224, -0.6},
+    { 0,  0,  0, 2, 1,    -386,   -0.4,   200,  0.0},
+    { 0,  0,  1, 2, 2,    -301,    0.0,   129, -0.1},
+    {-2, -1,  0, 2, 2,     217,   -0.5,   -95,  0.3},
+    {-2,  0,  1, 0, 0,    -158,    0.0,     0,  0.0},
+    {-2,  0,  0, 2, 1,     129,    0.1,   -70,  0.0},
+    { 0,  0, -1, 2, 2,     123,    0.0,   -53,  0.0},
+};
+
+// frame rotations
+static void rotX(double a, double r[3][3])
+{
+    double c = cos(a), s = sin(a);
+    double m[3][3] = {{1, 0, 0}, {0, c, s}, {0, -s, c}};
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++)
+            r[i][j] = m[i][j];
+}
+
+static void rotY(double a, double r[3][3])
+{
+    double c = cos(a), s = sin(a);
+    double m[3][3] = {{c, 0, -s}, {0, 1, 0}, {s, 0, c}};
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++)
+            r[i][j] = m[i][j];
+}
+
+static void rotZ(double a, double r[3][3])
+{
+    double c = cos(a), s = sin(a);
+    double m[3][3] = {{c, s, 0}, {-s, c, 0}, {0, 0, 1}};
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++)
+            r[i][j] = m[i][j];
+}
+
+static void multiply(const double a[3][3], const double b[3][3], double r[3][3])
+{
+    double m[3][3];
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++)
+            m[i][j] = a[i][0] * b[0][j] + a[i][1] * b[1][j] + a[i][2] * b[2][j];
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++)
+            r[i][j] = m[i][j];
+}
+
+static void toVector(double ra, double dec, double v[3])
+{
+    double a = ra * 15 * degree;
+    double d = dec * degree;
+    v[0] = cos(d) * cos(a);
+    v[1] = cos(d) * sin(a);
+    v[2] = sin(d);
+}
+
+static std::tuple<double, double> fromVector(const double v[3])
+{
+    double ra = atan2(v[1], v[0]) / (15 * degree);
+    if (ra < 0)
+        ra += 24;
+    double dec = atan2(v[2], sqrt(v[0] * v[0] + v[1] * v[1])) / degree;
+    return std::make_tuple(ra, dec);
+}
+
+// Meeus, refraction in arcmin
+static double saemundsson(double h)
+{
+    return 1.02 / tan((h + 10.3 / (h + 5.11)) * degree);
+}
+
+static double bennett(double h0)
+{
+    return 1.0 / tan((h0 + 7.31 / (h0 + 4.4)) * degree);
+}
+
+Astrometry::Refraction::Refraction()
+{
+    for (int i = 0; i < refraction_steps; i++)
+    {
+        double alt = refraction_min + i * refraction_step;
+        true_alt[i] = fmax(0, saemundsson(alt) / 60);
+        observed_alt[i] = fmax(0, bennett(alt) / 60);
+    }
+}
+
+// tables are the same for every site, built once and only read afterwards
+const Astrometry::Refraction &Astrometry::Tables()
+{
+    static const Refraction tables;
+    return tables;
+}
+
+Astrometry::Astrometry()
+    : refraction(&Tables())
+{
+    epoch.valid = false;
+    tolerance = 600LL * 1000000000LL;
+    SetConditions(10, 1010);
+}
+
+void Astrometry::SetTolerance(double seconds)
+{
+    tolerance = (int64_t)(seconds * 1e9);
+    epoch.valid = false;
+}
+
+void Astrometry::SetConditions(double temperature, double pressure)
+{
+    atmosphere = pressure / 1010 * 283 / (273 + temperature);
+}
+
+void Astrometry::Update(int64_t time)
+{
+    double jd = jd_unix + (Timebase::ToUTC(time) / 1e9 + tt_utc) / 86400;
+    double T = (jd - 2451545.0) / 36525;
+    double T2 = T * T;
+    double T3 = T2 * T;
+
+    // precession
+    double zeta = (2306.2181 * T + 0.30188 * T2 + 0.017998 * T3) * arcsec;
+    double z = (2306.2181 * T + 1.09468 * T2 + 0.018203 * T3) * arcsec;
+    double theta = (2004.3109 * T - 0.42665 * T2 - 0.041833 * T3) * arcsec;
+    double p[3][3], r[3][3];
+    rotZ(-zeta, p);
+    rotY(theta, r);
+    multiply(r, p, p);
+    rotZ(-z, r);
+    multiply(r, p, p);
+
+    // nutation
+    double D = (297.85036 + 445267.111480 * T - 0.0019142 * T2 + T3 / 189474) * degree;
+    double M = (357.52772 + 35999.050340 * T - 0.0001603 * T2 - T3 / 300000) * degree;
+    double Mp = (134.96298 + 477198.867398 * T + 0.0086972 * T2 + T3 / 56250) * degree;
+    double F = (93.27191 + 483202.017538 * T - 0.0036825 * T2 + T3 / 327270) * degree;
+    double Om = (125.04452 - 1934.136261 * T + 0.0020708 * T2 + T3 / 450000) * degree;
+    double dpsi = 0, deps = 0;
+    for (const NutationTerm &t : nutation_terms)
+    {
+        double arg = t.d * D + t.m * M + t.mp * Mp + t.f * F + t.om * Om;
+        dpsi += (t.psi + t.psi_t * T) * sin(arg);
+        deps += (t.eps + t.eps_t * T) * cos(arg);
+    }
+    dpsi *= 1e-4 * arcsec;
+    deps *= 1e-4 * arcsec;
+    double eps0 = (84381.448 - 46.8150 * T - 0.00059 * T2 + 0.001813 * T3) * arcsec;
+    double eps = eps0 + deps;
+
+    double n[3][3];
+    rotX(eps0, n);
+    rotZ(-dpsi, r);
+    multiply(r, n, n);
+    rotX(-eps, r);
+    multiply(r, n, n);
+    multiply(n, p, epoch.np);
+
+    // Earth velocity over c, ecliptic of date to equator of date
+    double L0 = (280.46646 + 36000.76983 * T) * degree;
+    double Ms = (357.52911 + 35999.05029 * T) * degree;
+    double e = 0.016708634 - 0.000042037 * T;
+    double C = ((1.914602 - 0.004817 * T) * sin(Ms) + (0.019993 - 0.000101 * T) * sin(2 * Ms)
+                + 0.000289 * sin(3 * Ms)) * degree;
+    double sun = L0 + C;
+    double perihelion = (102.93735 + 1.71946 * T) * degree;
+    double kappa = 20.49552 * arcsec;
+    double vx = kappa * (sin(sun) - e * sin(perihelion));
+    double vy = -kappa * (cos(sun) - e * cos(perihelion));
+    epoch.velocity[0] = vx;
+    epoch.velocity[1] = vy * cos(eps);
+    epoch.velocity[2] = vy * sin(eps);
+
+    epoch.eqeq = dpsi * cos(eps) / (15 * degree);
+    epoch.time = time;
+    epoch.valid = true;
+}
+
+const Astrometry::Epoch &Astrometry::At(int64_t time)
+{
+    if (!epoch.valid || llabs(time - epoch.time) > tolerance)
+        Update(time);
+    return epoch;
+}
+
+std::tuple<double, double> Astrometry::J2000ToApparent(double ra, double dec, int64_t time)
+{
+    const Epoch &ep = At(time);
+    double v[3], t[3];
+    toVector(ra, dec, v);
+    for (int i = 0; i < 3; i++)
+        t[i] = ep.np[i][0] * v[0] + ep.np[i][1] * v[1] + ep.np[i][2] * v[2];
+
+    // first order annual aberration
+    double pv = t[0] * ep.velocity[0] + t[1] * ep.velocity[1] + t[2] * ep.velocity[2];
+    for (int i = 0; i < 3; i++)
+        t[i] += ep.velocity[i] - t[i] * pv;
+    return fromVector(t);
+}
+
+std::tuple<double, double> Astrometry::ApparentToJ2000(double ra, double dec, int64_t time)
+{
+    const Epoch &ep = At(time);
+    double v[3], t[3];
+    toVector(ra, dec, t);
+    double pv = t[0] * ep.velocity[0] + t[1] * ep.velocity[1] + t[2] * ep.velocity[2];
+    for (int i = 0; i < 3; i++)
+        t[i] += t[i] * pv - ep.velocity[i];
+
+    // rotation is orthogonal, inverse is transposed
+    for (int i = 0; i < 3; i++)
+        v[i] = ep.np[0][i] * t[0] + ep.np[1][i] * t[1] + ep.np[2][i] * t[2];
+    return fromVector(v);
+}
+
+double Astrometry::EquationOfEquinoxes(int64_t time)
+{
+    return At(time).eqeq;
+}
+
+double Astrometry::Table(const double *table, double alt)
+{
+    double pos = (alt - refraction_min) / refraction_step;
+    if (pos <= 0)
+        return table[0];
+    if (pos >= refraction_steps - 1)
+        return table[refraction_steps - 1];
+    int i = (int)pos;
+    double f = pos - i;
+    return table[i] + (table[i + 1] - table[i]) * f;
+}
+
+double Astrometry::Refract(double alt)
+{
+    return alt + atmosphere * Table(refraction->true_alt, alt);
+}
+
+double Astrometry::Unrefract(double alt)
+{
+    // Bennett is within a few arcsec of inverse Saemundsson,
+    // refine so Unrefract(Refract(h)) == h
+    double h = alt - atmosphere * Table(refraction->observed_alt, alt);
+    for (int i = 0; i < 2; i++)
+        h = alt - atmosphere * Table(refraction->true_alt, h);
+    return h;
+}
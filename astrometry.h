@@ -0,0 +1,70 @@
+#ifndef ASTROMETRY_H
+#define ASTROMETRY_H
+
+#include <cstdint>
+#include <tuple>
+
+/*
+ * Catalog (J2000 mean) to apparent place and atmospheric refraction.
+ *
+ * Precession is IAU 1976, nutation is the 13 largest terms of IAU 1980
+ * (better than 0.05"), annual aberration uses Earth velocity from the
+ * low precision solar theory. Combined rotation matrix, aberration vector
+ * and equation of the equinoxes are cached and recomputed only when time
+ * moves more than tolerance from the cached epoch.
+ *
+ * Refraction comes from tables over altitude at 1010 hPa and 10 C,
+ * scaled by pressure and temperature (Saemundsson and Bennett formulas).
+ * Tables are shared by all instances.
+ *
+ * Times are Timebase nanoseconds, RA in hours, angles in degrees.
+ */
+class Astrometry
+{
+public:
+    static const int refraction_steps = 1821;
+private:
+    struct Epoch
+    {
+        bool valid;
+        int64_t time;
+        double np[3][3];
+        double velocity[3];
+        double eqeq;
+    };
+
+    // refraction in degrees, indexed by true and by observed altitude
+    struct Refraction
+    {
+        double true_alt[refraction_steps];
+        double observed_alt[refraction_steps];
+        Refraction();
+    };
+private:
+    Epoch epoch;
+    int64_t tolerance;
+    const Refraction *refraction;
+    double atmosphere;
+private:
+    static const Refraction &Tables();
+    void Update(int64_t time);
+    const Epoch &At(int64_t time);
+    double Table(const double *table, double alt);
+public:
+    Astrometry();
+
+    void SetTolerance(double seconds);
+    // Celsius and hPa
+    void SetConditions(double temperature, double pressure);
+
+    std::tuple<double, double> J2000ToApparent(double ra, double dec, int64_t time);
+    std::tuple<double, double> ApparentToJ2000(double ra, double dec, int64_t time);
+    // Apparent minus mean sidereal time, hours
+    double EquationOfEquinoxes(int64_t time);
+
+    // Altitude with refraction added / removed
+    double Refract(double alt);
+    double Unrefract(double alt);
+};
+
+#endif // ASTROMETRY_H
@@ -0,0 +1,31 @@
+#include <cmath>
+#include "chebyshev.h"
+
+double ChebyshevNode(int k, int n)
+{
+    return cos(M_PI * (k + 0.5) / n);
+}
+
+void ChebyshevFit(const double *values, int n, double *coeffs)
+{
+    for (int j = 0; j < n; j++)
+    {
+        double s = 0;
+        for (int k = 0; k < n; k++)
+            s += values[k] * cos(M_PI * j * (k + 0.5) / n);
+        coeffs[j] = s * 2 / n;
+    }
+    coeffs[0] /= 2;
+}
+
+double ChebyshevEval(const double *coeffs, int n, double x)
+{
+    double b1 = 0, b2 = 0;
+    for (int j = n - 1; j >= 1; j--)
+    {
+        double b = 2 * x * b1 - b2 + coeffs[j];
+        b2 = b1;
+        b1 = b;
+    }
+    return x * b1 - b2 + coeffs[0];
+}
@@ -0,0 +1,16 @@
+#ifndef CHEBYSHEV_H
+#define CHEBYSHEV_H
+
+/*
+ * Chebyshev series on [-1, 1].
+ * Fit takes values at the n Chebyshev nodes and gives n coefficients,
+ * series is exact at the nodes and close to minimax between them.
+ */
+
+// k-th of n nodes, descending from near 1 to near -1
+double ChebyshevNode(int k, int n);
+void ChebyshevFit(const double *values, int n, double *coeffs);
+// Clenshaw recurrence
+double ChebyshevEval(const double *coeffs, int n, double x);
+
+#endif // CHEBYSHEV_H
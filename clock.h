@@ -0,0 +1,38 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <cstdint>
+#include <atomic>
+
+/*
+ * Source of Timebase time, nanoseconds.
+ * Default one is the monotonic clock, simulation installs its own
+ * with Timebase::SetClock() to run faster than real time.
+ */
+class Clock
+{
+public:
+    virtual ~Clock() {}
+    virtual int64_t Now() = 0;
+};
+
+// Time moves only when told to
+class VirtualClock : public Clock
+{
+private:
+    std::atomic<int64_t> time;
+public:
+    VirtualClock(int64_t start) : time(start) {}
+
+    int64_t Now() override
+    {
+        return time.load(std::memory_order_acquire);
+    }
+
+    void Advance(int64_t nsec)
+    {
+        time.fetch_add(nsec, std::memory_order_acq_rel);
+    }
+};
+
+#endif // CLOCK_H
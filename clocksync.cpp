@@ -0,0 +1,135 @@
+#include "clocksync.h"
+
+// crystals of both sides are well within this
+static const double max_drift = 500e-6;
+static const int64_t sample_interval = 1000000;
+
+ClockSync::ClockSync()
+{
+    Reset();
+}
+
+void ClockSync::Reset()
+{
+    count = 0;
+    next = 0;
+    has_stamp = false;
+    last_stamp = 0;
+    stamp_epoch = 0;
+    valid = false;
+    reference = 0;
+    offset = 0;
+    drift = 0;
+    min_delay = 0;
+}
+
+int64_t ClockSync::Unwrap(uint32_t stamp)
+{
+    if (has_stamp && stamp < last_stamp)
+        stamp_epoch += (int64_t)1 << 32;
+    has_stamp = true;
+    last_stamp = stamp;
+    return stamp_epoch + stamp;
+}
+
+void ClockSync::AddSample(int64_t sent, int64_t received, int64_t stamp)
+{
+    if (received < sent)
+        return;
+    Sample sample;
+    sample.host = sent + (received - sent) / 2;
+    sample.offset = stamp - sample.host;
+    sample.delay = received - sent;
+
+    // window keeps the best sample of every interval, so it spans
+    // enough time to see the drift
+    if (count > 0)
+    {
+        Sample &last = samples[(next + window - 1) % window];
+        if (sample.host - last.host < sample_interval)
+        {
+            if (sample.delay < last.delay)
+            {
+                last = sample;
+                Fit();
+            }
+            return;
+        }
+    }
+    samples[next] = sample;
+    next = (next + 1) % window;
+    if (count < window)
+        count++;
+    Fit();
+}
+
+void ClockSync::Fit()
+{
+    min_delay = samples[0].delay;
+    for (int i = 1; i < count; i++)
+        if (samples[i].delay < min_delay)
+            min_delay = samples[i].delay;
+
+    // samples delayed by queueing on either side are off by up to half the delay
+    int64_t max_delay = 2 * min_delay + 100;
+    reference = samples[(next + window - 1) % window].host;
+    double n = 0, st = 0, so = 0, stt = 0, sto = 0;
+    double t_min = 0, t_max = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (samples[i].delay > max_delay)
+            continue;
+        double t = samples[i].host - reference;
+        double o = samples[i].offset;
+        if (n == 0 || t < t_min)
+            t_min = t;
+        if (n == 0 || t > t_max)
+            t_max = t;
+        n++;
+        st += t;
+        so += o;
+        stt += t * t;
+        sto += t * o;
+    }
+
+    offset = so / n;
+    drift = 0;
+    // slope needs some time span to be better than the noise
+    if (n >= 3 && t_max - t_min >= 1e6)
+    {
+        double d = n * stt - st * st;
+        drift = (n * sto - st * so) / d;
+        if (drift > max_drift)
+            drift = max_drift;
+        else if (drift < -max_drift)
+            drift = -max_drift;
+        offset = (so - drift * st) / n;
+    }
+    valid = true;
+}
+
+bool ClockSync::Synchronized() const
+{
+    return valid;
+}
+
+int64_t ClockSync::ToHost(int64_t stamp) const
+{
+    // stamp = host + offset + drift * (host - reference)
+    return (int64_t)((stamp - offset + drift * reference) / (1 + drift));
+}
+
+double ClockSync::Offset() const
+{
+    return offset;
+}
+
+double ClockSync::Drift() const
+{
+    return drift * 1e6;
+}
+
+int64_t ClockSync::Delay() const
+{
+    return min_delay;
+}
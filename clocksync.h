@@ -0,0 +1,59 @@
+#ifndef CLOCKSYNC_H
+#define CLOCKSYNC_H
+
+#include <cstdint>
+#include "timebase.h"
+
+/*
+ * Offset and drift of controller clock against host monotonic clock.
+ *
+ * Every position reply with a controller timestamp gives NTP-style
+ * sample: offset = stamp - (sent + received) / 2, with round-trip delay
+ * as its error bound. Samples close to the smallest delay in the window
+ * are fitted with a line, its slope is the drift.
+ */
+class ClockSync
+{
+public:
+    static const int window = 32;
+private:
+    struct Sample
+    {
+        int64_t host;
+        int64_t offset;
+        int64_t delay;
+    };
+private:
+    Sample samples[window];
+    int count;
+    int next;
+
+    bool has_stamp;
+    uint32_t last_stamp;
+    int64_t stamp_epoch;
+
+    // controller = host + offset + drift * (host - reference)
+    bool valid;
+    int64_t reference;
+    double offset;
+    double drift;
+    int64_t min_delay;
+private:
+    void Fit();
+public:
+    ClockSync();
+    void Reset();
+
+    // Extends 32-bit wrapping controller time, stamps must come in order
+    int64_t Unwrap(uint32_t stamp);
+    void AddSample(int64_t sent, int64_t received, int64_t stamp);
+
+    bool Synchronized() const;
+    int64_t ToHost(int64_t stamp) const;
+    double Offset() const;
+    // ppm
+    double Drift() const;
+    int64_t Delay() const;
+};
+
+#endif // CLOCKSYNC_H
@@ -1,3 +1,5 @@
+#include <QSettings>
+#include <QFileInfo>
 #include "config.h"
 
 Config::Config()
@@ -6,4 +8,63 @@ Config::Config()
     y_steps = 921600UL;
     x_rotation_time = 180;
     y_rotation_time = 180;
+    x_acceleration_time = 2;
+    y_acceleration_time = 2;
+    lookahead = 10;
+    segment_time = 2;
+    lookahead_thread = true;
+    control_rate = 2;
+    control_realtime = false;
+    control_priority = 50;
+    satellite_rate = 20;
+    satellite_lookahead = 2;
+    satellite_segment_time = 0.1;
+    position_max_age = 250;
+    queue_size = 2;
+    binary_protocol = true;
+    telemetry_interval = 60000;
+    astrometry = true;
+    temperature = 10;
+    pressure = 1010;
+}
+
+bool Config::Load(const QString &filename)
+{
+    if (!QFileInfo(filename).isReadable())
+        return false;
+    QSettings settings(filename, QSettings::IniFormat);
+    if (settings.status() != QSettings::NoError)
+        return false;
+
+    settings.beginGroup("mount");
+    x_steps = settings.value("x_steps", x_steps).toInt();
+    y_steps = settings.value("y_steps", y_steps).toInt();
+    x_rotation_time = settings.value("x_rotation_time", x_rotation_time).toInt();
+    y_rotation_time = settings.value("y_rotation_time", y_rotation_time).toInt();
+    x_acceleration_time = settings.value("x_acceleration_time", x_acceleration_time).toDouble();
+    y_acceleration_time = settings.value("y_acceleration_time", y_acceleration_time).toDouble();
+    position_max_age = settings.value("position_max_age", position_max_age).toInt();
+    queue_size = settings.value("queue_size", queue_size).toInt();
+    binary_protocol = settings.value("binary_protocol", binary_protocol).toBool();
+    telemetry_interval = settings.value("telemetry_interval", telemetry_interval).toInt();
+    settings.endGroup();
+
+    settings.beginGroup("tracking");
+    lookahead = settings.value("lookahead", lookahead).toDouble();
+    segment_time = settings.value("segment_time", segment_time).toDouble();
+    lookahead_thread = settings.value("lookahead_thread", lookahead_thread).toBool();
+    control_rate = settings.value("control_rate", control_rate).toDouble();
+    control_realtime = settings.value("control_realtime", control_realtime).toBool();
+    control_priority = settings.value("control_priority", control_priority).toInt();
+    satellite_rate = settings.value("satellite_rate", satellite_rate).toDouble();
+    satellite_lookahead = settings.value("satellite_lookahead", satellite_lookahead).toDouble();
+    satellite_segment_time = settings.value("satellite_segment_time", satellite_segment_time).toDouble();
+    settings.endGroup();
+
+    settings.beginGroup("site");
+    astrometry = settings.value("astrometry", astrometry).toBool();
+    temperature = settings.value("temperature", temperature).toDouble();
+    pressure = settings.value("pressure", pressure).toDouble();
+    settings.endGroup();
+    return true;
 }
@@ -1,14 +1,43 @@
 #ifndef CONFIG_H
 #define CONFIG_H
 
+#include <QString>
+
 class Config {
 public:
     int x_steps;
     int y_steps;
     int x_rotation_time;
     int y_rotation_time;
+    // seconds to reach full speed on goto
+    double x_acceleration_time;
+    double y_acceleration_time;
+    // seconds of segments precomputed ahead by worker thread, 0 tracks from GUI timer
+    double lookahead;
+    double segment_time;
+    // false leaves lookahead to MountSystem::ProcessLookahead() calls
+    bool lookahead_thread;
+    // control loop rate, Hz, and SCHED_FIFO priority when realtime
+    double control_rate;
+    bool control_realtime;
+    int control_priority;
+    // satellites: control loop rate, Hz, lookahead and segment length, s
+    double satellite_rate;
+    double satellite_lookahead;
+    double satellite_segment_time;
+    int position_max_age;
+    int queue_size;
+    bool binary_protocol;
+    int telemetry_interval;
+    // apparent places and refraction for RA/Dec, Celsius, hPa
+    bool astrometry;
+    double temperature;
+    double pressure;
 public:
     Config();
+
+    // Overrides defaults with keys of the same names from ini file
+    bool Load(const QString &filename);
 };
 
 #endif // CONFIG_H
@@ -0,0 +1,173 @@
+#include "controlloop.h"
+#include "timebase.h"
+#include <QDebug>
+#include <QtMath>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <string.h>
+#include <errno.h>
+
+static const qint64 nsec_per_sec = 1000000000LL;
+
+static qint64 ToNsec(const struct timespec &ts)
+{
+    return ts.tv_sec * nsec_per_sec + ts.tv_nsec;
+}
+
+static struct timespec FromNsec(qint64 t)
+{
+    struct timespec ts;
+    ts.tv_sec = t / nsec_per_sec;
+    ts.tv_nsec = t % nsec_per_sec;
+    return ts;
+}
+
+static qint64 MonotonicNow()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ToNsec(ts);
+}
+
+ControlLoop::ControlLoop(MountDevice *ctl, MountSystem *system, double rate,
+                         bool realtime, int priority, QObject *parent)
+    : QThread(parent)
+{
+    this->ctl = ctl;
+    this->system = system;
+    base_period = qRound64(nsec_per_sec / rate);
+    period = base_period;
+    this->realtime = realtime;
+    this->priority = priority;
+    phase = 0;
+    running = false;
+    overruns = 0;
+    read_failures = 0;
+}
+
+ControlLoop::~ControlLoop()
+{
+    Stop();
+}
+
+void ControlLoop::Start()
+{
+    running = true;
+    start();
+}
+
+void ControlLoop::Stop()
+{
+    running = false;
+    wait();
+}
+
+void ControlLoop::SetRealtime()
+{
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = qBound(sched_get_priority_min(SCHED_FIFO), priority,
+                                  sched_get_priority_max(SCHED_FIFO));
+    int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (err != 0)
+        qWarning() << "Control loop stays at normal priority:" << strerror(err);
+}
+
+void ControlLoop::run()
+{
+    if (realtime)
+        SetRealtime();
+
+    qint64 deadline = GridBefore(MonotonicNow());
+    qint64 last = Timebase::Now();
+    while (running)
+    {
+        deadline += period;
+        struct timespec ts = FromNsec(deadline);
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR)
+            ;
+
+        qint64 woke = MonotonicNow();
+        lateness.Record((woke - deadline) / 1000);
+
+        auto p = ctl->ReadPositionTimed();
+        if (!std::get<0>(p))
+        {
+            read_failures++;
+            emit positionLost();
+            continue;
+        }
+        system->UpdatePosition(std::get<1>(p), std::get<2>(p), std::get<3>(p));
+
+        // segments are planned for time that really passed, not the nominal period
+        qint64 now = Timebase::Now();
+        system->TrackingPeriodic((now - last) / 1e9);
+        last = now;
+        emit ticked();
+
+        double rate = system->ControlRate();
+        qint64 wanted = rate > 0 ? qRound64(nsec_per_sec / rate) : base_period;
+        if (wanted != period)
+        {
+            period = wanted;
+            deadline = GridBefore(MonotonicNow());
+        }
+
+        // too late for the next deadline as well, start over from now
+        qint64 done = MonotonicNow();
+        if (done > deadline + period)
+        {
+            overruns++;
+            deadline = GridBefore(done);
+        }
+    }
+}
+
+void ControlLoop::SetPhase(double fraction)
+{
+    phase = fraction - floor(fraction);
+}
+
+// last deadline on the grid of period shifted by phase
+qint64 ControlLoop::GridBefore(qint64 time)
+{
+    qint64 p = period;
+    qint64 grid = time - time % p + qRound64(phase * p);
+    if (grid > time)
+        grid -= p;
+    return grid;
+}
+
+double ControlLoop::Period()
+{
+    return period / 1e9;
+}
+
+const LatencyHistogram &ControlLoop::Lateness()
+{
+    return lateness;
+}
+
+quint64 ControlLoop::Overruns()
+{
+    return overruns;
+}
+
+quint64 ControlLoop::ReadFailures()
+{
+    return read_failures;
+}
+
+QString ControlLoop::Report()
+{
+    return QString("Control loop %1 Hz: ticks %2, lateness mean %3 us p99 %4 us max %5 us, "
+                   "overruns %6, position read failures %7")
+            .arg(1 / Period())
+            .arg((quint64)lateness.Count())
+            .arg(lateness.Mean(), 0, 'f', 1)
+            .arg((quint64)lateness.Percentile(99))
+            .arg((quint64)lateness.Max())
+            .arg(overruns.load())
+            .arg(read_failures.load());
+}
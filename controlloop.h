@@ -0,0 +1,67 @@
+#ifndef CONTROLLOOP_H
+#define CONTROLLOOP_H
+
+#include <QThread>
+#include <QString>
+#include <atomic>
+#include "mountdevice.h"
+#include "mountsystem.h"
+#include "latencyhistogram.h"
+
+/*
+ * Tracking loop on its own thread.
+ *
+ * Wakes up on absolute deadlines of CLOCK_MONOTONIC, so period errors do
+ * not add up, reads mount position and runs MountSystem::TrackingPeriodic
+ * with the time really elapsed since the previous tick. Deadlines that
+ * were missed completely are skipped, not caught up. Rate follows
+ * MountSystem::ControlRate(), e.g. faster while tracking a satellite.
+ *
+ * Wakeup lateness is kept in a histogram, GUI only listens to ticked().
+ */
+class ControlLoop : public QThread
+{
+    Q_OBJECT
+private:
+    MountDevice *ctl;
+    MountSystem *system;
+    qint64 base_period;             // nsec
+    std::atomic<qint64> period;     // now, MountSystem may ask for faster
+    double phase;
+    bool realtime;
+    int priority;
+    std::atomic<bool> running;
+
+    LatencyHistogram lateness;
+    std::atomic<quint64> overruns;
+    std::atomic<quint64> read_failures;
+private:
+    void SetRealtime();
+    qint64 GridBefore(qint64 time);
+protected:
+    void run() override;
+public:
+    // rate in Hz, realtime asks for SCHED_FIFO with given priority
+    ControlLoop(MountDevice *ctl, MountSystem *system, double rate,
+                bool realtime = false, int priority = 50, QObject *parent = nullptr);
+    ~ControlLoop();
+
+    // Ticks this fraction of period after whole periods of monotonic clock,
+    // so loops of several mounts can be spread apart. Call before Start()
+    void SetPhase(double fraction);
+    void Start();
+    void Stop();
+
+    double Period();
+    // wakeup later than deadline, usec
+    const LatencyHistogram &Lateness();
+    // ticks that missed the next deadline too
+    quint64 Overruns();
+    quint64 ReadFailures();
+    QString Report();
+signals:
+    void ticked();
+    void positionLost();
+};
+
+#endif // CONTROLLOOP_H
@@ -1,44 +1,21 @@
 #include <QtMath>
 #include "coordinatesystem.h"
+#include "mathkernels.h"
 
 CoordinateSystem::CoordinateSystem(QTimeZone tz, double longitude, double latitude)
+    : sidereal(longitude)
 {
     this->tz = tz;
     this->longitude = longitude;
     this->latitude = latitude;
-    datetime2000 = QDateTime(QDate(2000, 1, 1), QTime(0, 0, 0, 0), QTimeZone::utc());
+    sin_lat = sin(latitude * M_PI/180);
+    cos_lat = cos(latitude * M_PI/180);
+    apparent_places = true;
 }
 
-
-qint64 CoordinateSystem::Time2000(QDateTime datetime)
-{
-    qint64 timenow = datetime.toSecsSinceEpoch();
-    qint64 time2000 = datetime2000.toSecsSinceEpoch();
-    return timenow - time2000;
-}
-
-std::tuple<qint64, double, double> CoordinateSystem::GlobalSidericTime(QDateTime datetime)
-{
-    double delta = Time2000(datetime) / 86400.0;
-    const double L0 = 99.967794687;
-    const double L1 = 360.98564736628603;
-    const double L2 = 2.907879e-13;
-    const double L3 = -5.302e-22;
-
-    double angle = L0 + L1 * delta + L2 * delta*delta + L3 * delta*delta*delta;
-    qint64 rounds = floor(angle / 360);
-    double gst = angle - rounds * 360;
-    return std::make_tuple(rounds, gst * 24 / 360, angle * 24/360);
-}
-
-std::tuple<qint64, double, double> CoordinateSystem::LocalSidericTime(QDateTime datetime)
+double CoordinateSystem::LocalSidericTime(qint64 time)
 {
-    std::tuple<qint64, double, double> gst = GlobalSidericTime(datetime);
-    double total_gst = std::get<2>(gst);
-    double total_lst = total_gst + longitude * 24/360;
-    qint64 rounds = floor(total_lst / 24);
-    double lst = total_lst - rounds * 24;
-    return std::make_tuple(rounds, lst, total_lst);
+    return sidereal.LST(time);
 }
 
 double CoordinateSystem::ra2ha(double ra, double lst)
@@ -61,16 +38,155 @@ double CoordinateSystem::ha2ra(double ha, double lst)
     return ra;
 }
 
-double CoordinateSystem::Convert_HA2RA(double ha, QDateTime datetime)
+double CoordinateSystem::Convert_HA2RA(double ha, qint64 time)
+{
+    return ha2ra(ha, LocalSidericTime(time));
+}
+
+double CoordinateSystem::Convert_RA2HA(double ra, qint64 time)
+{
+    return ra2ha(ra, LocalSidericTime(time));
+}
+
+double CoordinateSystem::Convert_HA2RA(double ha)
+{
+    return ha2ra(ha, sidereal.Now());
+}
+
+double CoordinateSystem::Convert_RA2HA(double ra)
+{
+    return ra2ha(ra, sidereal.Now());
+}
+
+const SiderealClock *CoordinateSystem::Sidereal()
+{
+    return &sidereal;
+}
+
+void CoordinateSystem::SetAstrometry(bool enable)
+{
+    apparent_places = enable;
+}
+
+void CoordinateSystem::SetAtmosphere(double temperature, double pressure)
+{
+    astrometry.SetConditions(temperature, pressure);
+}
+
+/*
+ * J2000 -> apparent RA/Dec -> HA with apparent sidereal time
+ * -> Az/Alt, refraction lifts altitude -> observed HA/Dec
+ */
+std::tuple<double, double> CoordinateSystem::Convert_RADec2HADec(double ra, double dec, qint64 time)
+{
+    double lst = LocalSidericTime(time);
+    if (!apparent_places)
+        return std::make_tuple(ra2ha(ra, lst), dec);
+
+    auto normed = Normalized_HA_Dec_Coordinates(ra2ha(ra, lst), dec);
+    bool inverted = std::get<0>(normed);
+    ra = ha2ra(std::get<1>(normed), lst);
+    dec = std::get<2>(normed);
+
+    auto app = astrometry.J2000ToApparent(ra, dec, time);
+    double last = lst + astrometry.EquationOfEquinoxes(time);
+    double ha = ra2ha(std::get<0>(app), last);
+    auto azalt = Convert_to_Az_Alt(ha, std::get<1>(app));
+    auto hadec = Convert_from_Az_Alt(std::get<0>(azalt), astrometry.Refract(std::get<1>(azalt)));
+    if (inverted)
+        return Inverted_HA_Dec_Coordinates(std::get<0>(hadec), std::get<1>(hadec));
+    return hadec;
+}
+
+std::tuple<double, double> CoordinateSystem::Convert_HADec2RADec(double ha, double dec, qint64 time)
+{
+    double lst = LocalSidericTime(time);
+    if (!apparent_places)
+        return std::make_tuple(ha2ra(ha, lst), dec);
+
+    auto normed = Normalized_HA_Dec_Coordinates(ha, dec);
+    bool inverted = std::get<0>(normed);
+
+    auto azalt = Convert_to_Az_Alt(std::get<1>(normed), std::get<2>(normed));
+    auto hadec = Convert_from_Az_Alt(std::get<0>(azalt), astrometry.Unrefract(std::get<1>(azalt)));
+    double last = lst + astrometry.EquationOfEquinoxes(time);
+    auto cat = astrometry.ApparentToJ2000(ha2ra(std::get<0>(hadec), last), std::get<1>(hadec), time);
+    if (!inverted)
+        return cat;
+
+    // same form as the input, beyond the pole
+    auto inv = Inverted_HA_Dec_Coordinates(ra2ha(std::get<0>(cat), lst), std::get<1>(cat));
+    return std::make_tuple(ha2ra(std::get<0>(inv), lst), std::get<1>(inv));
+}
+
+/*
+ * TEME is true equator and mean equinox, so mean sidereal time turns
+ * the site into it. Topocentric vector gives HA/Dec, refraction as above
+ */
+// site on WGS84 ellipsoid, km, equator and equinox of sidereal time lst
+void CoordinateSystem::SitePosition(double lst, double site[3])
+{
+    const double a = 6378.137;
+    const double e2 = 0.00669437999014;
+    double n = a / sqrt(1 - e2 * sin_lat * sin_lat);
+    lst = lst * M_PI / 12;
+    site[0] = n * cos_lat * cos(lst);
+    site[1] = n * cos_lat * sin(lst);
+    site[2] = n * (1 - e2) * sin_lat;
+}
+
+// topocentric HA/Dec of geocentric position r given in frame of lst
+std::tuple<double, double> CoordinateSystem::Topocentric(const double r[3], double lst)
+{
+    double site[3];
+    SitePosition(lst, site);
+    double x = r[0] - site[0];
+    double y = r[1] - site[1];
+    double z = r[2] - site[2];
+    double ra = atan2(y, x) * 12 / M_PI;
+    double dec = atan2(z, sqrt(x * x + y * y)) * 180 / M_PI;
+    double ha = fmod(lst - ra, 24);
+    if (ha < 0)
+        ha += 24;
+    if (!apparent_places)
+        return std::make_tuple(ha, dec);
+
+    auto azalt = Convert_to_Az_Alt(ha, dec);
+    return Convert_from_Az_Alt(std::get<0>(azalt), astrometry.Refract(std::get<1>(azalt)));
+}
+
+std::tuple<double, double> CoordinateSystem::Convert_AzAlt2HADec(double az, double alt)
+{
+    if (!apparent_places)
+        return Convert_from_Az_Alt(az, alt);
+    return Convert_from_Az_Alt(az, astrometry.Refract(alt));
+}
+
+std::tuple<double, double> CoordinateSystem::Convert_TEME2HADec(const double r[3], qint64 time)
 {
-    std::tuple<qint64, double, double> lst = LocalSidericTime(datetime);
-    return ha2ra(ha, std::get<1>(lst));
+    return Topocentric(r, LocalSidericTime(time));
 }
 
-double CoordinateSystem::Convert_RA2HA(double ra, QDateTime datetime)
+/*
+ * Direction goes to apparent place as for a star, distance is kept,
+ * then the site is subtracted in the frame of apparent sidereal time
+ */
+std::tuple<double, double> CoordinateSystem::Convert_Geocentric2HADec(const double r[3], qint64 time)
 {
-    std::tuple<qint64, double, double> lst = LocalSidericTime(datetime);
-    return ra2ha(ra, std::get<1>(lst));
+    double lst = LocalSidericTime(time);
+    if (!apparent_places)
+        return Topocentric(r, lst);
+
+    double dist = sqrt(r[0] * r[0] + r[1] * r[1] + r[2] * r[2]);
+    double ra = atan2(r[1], r[0]) * 12 / M_PI;
+    if (ra < 0)
+        ra += 24;
+    double dec = asin(r[2] / dist) * 180 / M_PI;
+    auto app = astrometry.J2000ToApparent(ra, dec, time);
+    ra = std::get<0>(app) * M_PI / 12;
+    dec = std::get<1>(app) * M_PI / 180;
+    double v[3] = {dist * cos(dec) * cos(ra), dist * cos(dec) * sin(ra), dist * sin(dec)};
+    return Topocentric(v, lst + astrometry.EquationOfEquinoxes(time));
 }
 
 /* http://www.stargazing.net/kepler/altaz.html
@@ -91,17 +207,16 @@ std::tuple<double, double> CoordinateSystem::Convert_to_Az_Alt(double ha, double
     ha = std::get<1>(normed);
     dec = std::get<2>(normed);
 
-    double LAT = latitude * M_PI/180;
     dec = dec * M_PI / 180;
     ha = ha * M_PI / 12;
-    double sinalt = sin(dec)*sin(LAT) + cos(dec)*cos(LAT)*cos(ha);
+    double sinalt = sin(dec)*sin_lat + cos(dec)*cos_lat*cos(ha);
     if (sinalt > 1)
         sinalt = 1;
     if (sinalt < -1)
         sinalt = -1;
 
     double alt = asin(sinalt);
-    double cosa = (sin(dec) - sinalt*sin(LAT)) / (cos(alt)*cos(LAT));
+    double cosa = (sin(dec) - sinalt*sin_lat) / (cos(alt)*cos_lat);
     if (cosa > 1)
         cosa = 1;
     if (cosa < -1)
@@ -132,16 +247,15 @@ std::tuple<double, double> CoordinateSystem::Convert_to_Az_Alt(double ha, double
 
 std::tuple<double, double> CoordinateSystem::Convert_from_Az_Alt(double az, double alt)
 {
-    double LAT = latitude * M_PI/180;
     az = az * M_PI/180;
     alt = alt * M_PI/180;
-    double sindec = sin(alt)*sin(LAT) + cos(alt)*cos(LAT)*cos(az);
+    double sindec = sin(alt)*sin_lat + cos(alt)*cos_lat*cos(az);
     if (sindec > 1)
         sindec = 1;
     if (sindec < -1)
         sindec = -1;
     double dec = asin(sindec);
-    double cosha = (sin(alt)-sin(LAT)*sindec) / (cos(LAT)*cos(dec));
+    double cosha = (sin(alt)-sin_lat*sindec) / (cos_lat*cos(dec));
     if (cosha > 1)
         cosha = 1;
     if (cosha < -1)
@@ -153,6 +267,62 @@ std::tuple<double, double> CoordinateSystem::Convert_from_Az_Alt(double az, doub
     return std::make_tuple(ha*12/M_PI, dec*180/M_PI);
 }
 
+/*
+ * Batch conversions use atan2 forms of the same relations, with
+ * horizontal (or equatorial) components of the unit vector
+ *
+ * cos(ALT)*cos(AZ) = sin(DEC)*cos(LAT) - cos(DEC)*cos(HA)*sin(LAT)
+ * cos(ALT)*sin(AZ) = -cos(DEC)*sin(HA)
+ *
+ * so no asin/acos and no branches are needed, loops are vectorized.
+ */
+
+void CoordinateSystem::Convert_to_Az_Alt(const double *ha, const double *dec, double *az, double *alt, int n)
+{
+    const double sl = sin_lat;
+    const double cl = cos_lat;
+    for (int i = 0; i < n; i++)
+    {
+        // normalize dec beyond the pole as Normalized_HA_Dec_Coordinates does
+        double d = dec[i];
+        bool inv = d > 90 || d < -90;
+        double h = inv ? ha[i] + 12 : ha[i];
+        d = inv ? (d > 0 ? 180 - d : -180 - d) : d;
+
+        double sh, ch, sd, cd;
+        kernel_sincos(h * (M_PI / 12), &sh, &ch);
+        kernel_sincos(d * (M_PI / 180), &sd, &cd);
+
+        double north = sd * cl - cd * ch * sl;
+        double east = -cd * sh;
+        double up = sd * sl + cd * cl * ch;
+        double a = kernel_atan2(east, north);
+        a = a < 0 ? a + 2 * M_PI : a;
+        az[i] = a * (180 / M_PI);
+        alt[i] = kernel_atan2(up, sqrt(north * north + east * east)) * (180 / M_PI);
+    }
+}
+
+void CoordinateSystem::Convert_from_Az_Alt(const double *az, const double *alt, double *ha, double *dec, int n)
+{
+    const double sl = sin_lat;
+    const double cl = cos_lat;
+    for (int i = 0; i < n; i++)
+    {
+        double sa, ca, sz, cz;
+        kernel_sincos(alt[i] * (M_PI / 180), &sa, &ca);
+        kernel_sincos(az[i] * (M_PI / 180), &sz, &cz);
+
+        double x = sa * cl - ca * cz * sl;
+        double y = -ca * sz;
+        double up = sa * sl + ca * cl * cz;
+        double h = kernel_atan2(y, x);
+        h = h < 0 ? h + 2 * M_PI : h;
+        ha[i] = h * (12 / M_PI);
+        dec[i] = kernel_atan2(up, sqrt(x * x + y * y)) * (180 / M_PI);
+    }
+}
+
 std::tuple<double, double> CoordinateSystem::Inverted_HA_Dec_Coordinates(double ha, double dec)
 {
     if (dec > 0)
@@ -2,6 +2,8 @@
 #define COORDINATESYSTEM_H
 
 #include <QTimeZone>
+#include "siderealclock.h"
+#include "astrometry.h"
 
 class CoordinateSystem
 {
@@ -9,21 +11,52 @@ private:
     QTimeZone tz;
     double latitude;
     double longitude;
-    QDateTime datetime2000;
+    double sin_lat;
+    double cos_lat;
+    SiderealClock sidereal;
+    Astrometry astrometry;
+    bool apparent_places;
 private:
-    qint64 Time2000(QDateTime datetime);
-    std::tuple<qint64, double, double> GlobalSidericTime(QDateTime datetime);
-    std::tuple<qint64, double, double> LocalSidericTime(QDateTime datetime);
+    double LocalSidericTime(qint64 time);
     double ra2ha(double ra, double lst);
     double ha2ra(double ha, double lst);
+    void SitePosition(double lst, double site[3]);
+    std::tuple<double, double> Topocentric(const double r[3], double lst);
 public:
     CoordinateSystem(QTimeZone tz, double longitude, double latitude);
-    double Convert_HA2RA(double ha, QDateTime datetime);
-    double Convert_RA2HA(double ra, QDateTime datetime);
+    // Time is Timebase nanoseconds
+    double Convert_HA2RA(double ha, qint64 time);
+    double Convert_RA2HA(double ra, qint64 time);
+    // Current time
+    double Convert_HA2RA(double ha);
+    double Convert_RA2HA(double ra);
+    const SiderealClock *Sidereal();
+
+    // Catalog J2000 RA/Dec to HA/Dec the mount points at and back.
+    // With astrometry enabled applies precession, nutation, aberration
+    // and refraction, otherwise it's plain RA <-> HA.
+    // Coordinates beyond the pole (dec > 90) are kept in the same form.
+    std::tuple<double, double> Convert_RADec2HADec(double ra, double dec, qint64 time);
+    std::tuple<double, double> Convert_HADec2RADec(double ha, double dec, qint64 time);
+    void SetAstrometry(bool enable);
+
+    // Observed HA/Dec of a near Earth object at TEME position, km,
+    // seen from the site (WGS84 ellipsoid at sea level)
+    std::tuple<double, double> Convert_TEME2HADec(const double r[3], qint64 time);
+    // Same for Sun, Moon and planets at geocentric astrometric ICRF position, km
+    std::tuple<double, double> Convert_Geocentric2HADec(const double r[3], qint64 time);
+    // Observed HA/Dec of geometric (unrefracted) Az/Alt, degrees
+    std::tuple<double, double> Convert_AzAlt2HADec(double az, double alt);
+    // Celsius, hPa
+    void SetAtmosphere(double temperature, double pressure);
 
     std::tuple<double, double> Convert_to_Az_Alt(double ha, double dec);
     std::tuple<double, double> Convert_from_Az_Alt(double az, double alt);
 
+    // Batch versions over n points in separate arrays, same units as above
+    void Convert_to_Az_Alt(const double *ha, const double *dec, double *az, double *alt, int n);
+    void Convert_from_Az_Alt(const double *az, const double *alt, double *ha, double *dec, int n);
+
     std::tuple<double, double> Inverted_HA_Dec_Coordinates(double ha, double dec);
     std::tuple<bool, double, double> Normalized_HA_Dec_Coordinates(double ha, double dec);
 };
@@ -0,0 +1,7 @@
+# Link gotocontrol-core, include from application .pro files
+INCLUDEPATH += $$PWD/..
+DEPENDPATH += $$PWD/..
+
+QT += serialport
+LIBS += -L$$OUT_PWD/../core -lgotocontrol-core
+PRE_TARGETDEPS += $$OUT_PWD/../core/libgotocontrol-core.a
@@ -0,0 +1,73 @@
+# Everything but widgets: mount link, coordinates, tracking, LX200 server.
+# Linked statically by the GUI, the daemon and the simulation harness.
+TEMPLATE = lib
+CONFIG += staticlib c++17
+
+QT       += core serialport
+QT       -= gui
+
+TARGET = gotocontrol-core
+
+# Batch coordinate kernels (mathkernels.h) are vectorized by the compiler,
+# it needs -O3 and math without errno and FP traps
+QMAKE_CXXFLAGS_RELEASE -= -O2
+QMAKE_CXXFLAGS_RELEASE += -O3
+QMAKE_CXXFLAGS += -fno-math-errno -fno-trapping-math
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+INCLUDEPATH += ..
+
+SOURCES += \
+    ../astrometry.cpp \
+    ../chebyshev.cpp \
+    ../clocksync.cpp \
+    ../config.cpp \
+    ../controlloop.cpp \
+    ../coordinatesystem.cpp \
+    ../ephemeris.cpp \
+    ../latencyhistogram.cpp \
+    ../lx200server.cpp \
+    ../mount.cpp \
+    ../mountcontroller.cpp \
+    ../mountlink.cpp \
+    ../mountprotocol.cpp \
+    ../mountregistry.cpp \
+    ../mountsystem.cpp \
+    ../pointingmodel.cpp \
+    ../replyreader.cpp \
+    ../segmentgenerator.cpp \
+    ../sgp4.cpp \
+    ../siderealclock.cpp \
+    ../slewplanner.cpp \
+    ../timebase.cpp \
+    ../tracker.cpp
+
+HEADERS += \
+    ../astrometry.h \
+    ../chebyshev.h \
+    ../clock.h \
+    ../clocksync.h \
+    ../config.h \
+    ../controlloop.h \
+    ../coordinatesystem.h \
+    ../ephemeris.h \
+    ../mathkernels.h \
+    ../latencyhistogram.h \
+    ../lx200server.h \
+    ../mount.h \
+    ../mountcontroller.h \
+    ../mountdevice.h \
+    ../mountlink.h \
+    ../mountprotocol.h \
+    ../mountregistry.h \
+    ../mountsystem.h \
+    ../pointingmodel.h \
+    ../replyreader.h \
+    ../segmentgenerator.h \
+    ../sgp4.h \
+    ../siderealclock.h \
+    ../slewplanner.h \
+    ../timebase.h \
+    ../spscqueue.h \
+    ../tracker.h
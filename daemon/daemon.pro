@@ -0,0 +1,17 @@
+QT       += core
+QT       -= gui
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = gotocontrold
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+include(../core/core.pri)
+
+SOURCES += \
+    main.cpp
+
+unix:!android: target.path = /opt/gotocontrol/bin
+!isEmpty(target.path): INSTALLS += target
@@ -0,0 +1,198 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QSocketNotifier>
+#include <QSettings>
+#include <QDebug>
+#include <signal.h>
+#include <unistd.h>
+#include "mountregistry.h"
+
+// SIGINT and SIGTERM reach the event loop through this pipe
+static int signal_pipe[2];
+
+static void on_signal(int)
+{
+    char c = 1;
+    ssize_t r = write(signal_pipe[1], &c, 1);
+    (void)r;
+}
+
+static MountRegistry::Settings ReadMount(QSettings &settings, const QString &group,
+                                         const MountRegistry::Settings &defaults)
+{
+    MountRegistry::Settings m = defaults;
+    settings.beginGroup(group);
+    m.port = settings.value("port", m.port).toString();
+    m.baudrate = settings.value("baudrate", m.baudrate).toInt();
+    m.timezone = settings.value("timezone", m.timezone).toString();
+    m.longitude = settings.value("longitude", m.longitude).toDouble();
+    m.latitude = settings.value("latitude", m.latitude).toDouble();
+    m.lx200 = settings.value("lx200", m.lx200).toString();
+    m.lx200_baudrate = settings.value("lx200_baudrate", m.lx200_baudrate).toInt();
+    settings.endGroup();
+    return m;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("gotocontrold");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Mount control daemon, LX200 clients connect to serial port or pseudo-terminal");
+    parser.addHelpOption();
+    QCommandLineOption configOption("config", "Ini file with [mount], [tracking], [site], [lx200] and [mount.<name>] settings.", "file");
+    QCommandLineOption portOption("port", "Mount serial port.", "port");
+    QCommandLineOption baudOption("baud", "Mount baud rate to negotiate.", "baud");
+    QCommandLineOption timezoneOption("timezone", "Site time zone.", "zone");
+    QCommandLineOption longitudeOption("longitude", "Site longitude, degrees.", "deg");
+    QCommandLineOption latitudeOption("latitude", "Site latitude, degrees.", "deg");
+    QCommandLineOption lx200Option("lx200", "LX200 serial port, \"pty\" for pseudo-terminal, empty disables.", "port");
+    QCommandLineOption lx200BaudOption("lx200-baud", "LX200 port baud rate.", "baud");
+    QCommandLineOption tleOption("tle", "File with two line elements of satellites.", "file");
+    QCommandLineOption satelliteOption("satellite", "Track satellite from TLE file on every mount, name or catalog number.", "name");
+    QCommandLineOption ephemerisOption("ephemeris", "Ephemeris file made by ephemgen.", "file");
+    QCommandLineOption bodyOption("body", "Track Sun, Moon or planet from ephemeris file on every mount.", "name");
+    parser.addOption(configOption);
+    parser.addOption(portOption);
+    parser.addOption(baudOption);
+    parser.addOption(timezoneOption);
+    parser.addOption(longitudeOption);
+    parser.addOption(latitudeOption);
+    parser.addOption(lx200Option);
+    parser.addOption(lx200BaudOption);
+    parser.addOption(tleOption);
+    parser.addOption(satelliteOption);
+    parser.addOption(ephemerisOption);
+    parser.addOption(bodyOption);
+    parser.process(a);
+
+    Config cfg;
+    MountRegistry::Settings defaults;
+    defaults.name = "mount";
+    defaults.port = "/dev/ttyUSB0";
+    defaults.baudrate = 115200;
+    defaults.timezone = "UTC";
+    defaults.longitude = 0;
+    defaults.latitude = 0;
+    defaults.lx200 = "pty";
+    defaults.lx200_baudrate = 9600;
+    QVector<MountRegistry::Settings> mounts;
+    if (parser.isSet(configOption))
+    {
+        QString filename = parser.value(configOption);
+        if (!cfg.Load(filename))
+        {
+            qCritical() << "Can not read" << filename;
+            return 1;
+        }
+        QSettings settings(filename, QSettings::IniFormat);
+        defaults = ReadMount(settings, "mount", defaults);
+        defaults.timezone = settings.value("site/timezone", defaults.timezone).toString();
+        defaults.longitude = settings.value("site/longitude", defaults.longitude).toDouble();
+        defaults.latitude = settings.value("site/latitude", defaults.latitude).toDouble();
+        defaults.lx200 = settings.value("lx200/port", defaults.lx200).toString();
+        defaults.lx200_baudrate = settings.value("lx200/baudrate", defaults.lx200_baudrate).toInt();
+
+        // more mounts in [mount.<name>] sections, missing keys are taken from above
+        for (const QString &group : settings.childGroups())
+        {
+            if (!group.startsWith("mount."))
+                continue;
+            MountRegistry::Settings m = ReadMount(settings, group, defaults);
+            m.name = group.mid(6);
+            mounts.append(m);
+        }
+    }
+    if (parser.isSet(portOption))
+        defaults.port = parser.value(portOption);
+    if (parser.isSet(baudOption))
+        defaults.baudrate = parser.value(baudOption).toInt();
+    if (parser.isSet(timezoneOption))
+        defaults.timezone = parser.value(timezoneOption);
+    if (parser.isSet(longitudeOption))
+        defaults.longitude = parser.value(longitudeOption).toDouble();
+    if (parser.isSet(latitudeOption))
+        defaults.latitude = parser.value(latitudeOption).toDouble();
+    if (parser.isSet(lx200Option))
+        defaults.lx200 = parser.value(lx200Option);
+    if (parser.isSet(lx200BaudOption))
+        defaults.lx200_baudrate = parser.value(lx200BaudOption).toInt();
+    TwoLineElements tle;
+    if (parser.isSet(satelliteOption))
+    {
+        QString name = parser.value(satelliteOption);
+        bool found = false;
+        for (const TwoLineElements &e : LoadTLE(parser.value(tleOption)))
+        {
+            if (e.name == name || QString::number(e.catalog) == name)
+            {
+                tle = e;
+                found = true;
+                break;
+            }
+        }
+        if (!found)
+        {
+            qCritical().noquote() << "No satellite" << name << "in" << parser.value(tleOption);
+            return 1;
+        }
+    }
+
+    Ephemeris ephemeris;
+    int body = -1;
+    if (parser.isSet(bodyOption))
+    {
+        QString error;
+        if (!ephemeris.Open(parser.value(ephemerisOption), &error))
+        {
+            qCritical().noquote() << error;
+            return 1;
+        }
+        body = ephemeris.Find(parser.value(bodyOption));
+        if (body < 0)
+        {
+            qCritical().noquote() << "No" << parser.value(bodyOption) << "in" << parser.value(ephemerisOption);
+            return 1;
+        }
+    }
+
+    // command line or [mount] alone describe the single mount
+    if (mounts.isEmpty() || parser.isSet(portOption))
+        mounts.prepend(defaults);
+
+    MountRegistry registry(cfg);
+    for (const MountRegistry::Settings &m : mounts)
+    {
+        QString error;
+        if (!registry.Add(m, &error))
+        {
+            qCritical().noquote() << m.name + ":" << error;
+            return 1;
+        }
+        qInfo().noquote() << m.name + ": mount on" << m.port
+                          << "LX200 on" << registry.LX200Endpoint(m.name);
+        if (parser.isSet(satelliteOption) && !registry.Get(m.name)->System()->GotoSatellite(tle))
+            qWarning().noquote() << m.name + ": can not track" << tle.name;
+        if (body >= 0 && !registry.Get(m.name)->System()->GotoBody(&ephemeris, body))
+            qWarning().noquote() << m.name + ": can not track" << ephemeris.Name(body);
+    }
+
+    // lost mount ends the daemon, supervisor restarts it
+    QObject::connect(&registry, &MountRegistry::positionLost, &a, [&a](const QString &name) {
+        qCritical().noquote() << name + ": mount does not answer";
+        a.exit(1);
+    });
+
+    if (pipe(signal_pipe) != 0)
+        return 1;
+    QSocketNotifier notifier(signal_pipe[0], QSocketNotifier::Read);
+    QObject::connect(&notifier, &QSocketNotifier::activated, &a, &QCoreApplication::quit);
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    int ret = a.exec();
+    qInfo().noquote() << registry.Report();
+    registry.Clear();
+    return ret;
+}
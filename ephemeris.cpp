@@ -0,0 +1,139 @@
+#include <cmath>
+#include <cstring>
+#include "ephemeris.h"
+#include "chebyshev.h"
+#include "timebase.h"
+
+static const double jd_unix = 2440587.5;
+// TDB - UTC, TDB is taken as TT (under 2 ms apart)
+static const double tt_utc = 69.184;
+
+Ephemeris::Ephemeris()
+{
+    file = nullptr;
+    data = nullptr;
+    bodies = nullptr;
+    count = 0;
+}
+
+Ephemeris::~Ephemeris()
+{
+    Close();
+}
+
+bool Ephemeris::Open(const QString &filename, QString *error)
+{
+    Close();
+    file = new QFile(filename);
+    if (!file->open(QIODevice::ReadOnly))
+    {
+        *error = filename + ": " + file->errorString();
+        Close();
+        return false;
+    }
+    qint64 size = file->size();
+    if (size < (qint64)sizeof(EphemerisHeader))
+    {
+        *error = filename + ": not an ephemeris file";
+        Close();
+        return false;
+    }
+    data = file->map(0, size);
+    if (!data)
+    {
+        *error = filename + ": " + file->errorString();
+        Close();
+        return false;
+    }
+
+    const EphemerisHeader *header = (const EphemerisHeader *)data;
+    qint64 table_end = sizeof(EphemerisHeader) + (qint64)header->bodies * sizeof(EphemerisBody);
+    if (memcmp(header->magic, ephemeris_magic, sizeof(ephemeris_magic)) != 0 || table_end > size)
+    {
+        *error = filename + ": not an ephemeris file";
+        Close();
+        return false;
+    }
+    bodies = (const EphemerisBody *)(data + sizeof(EphemerisHeader));
+    for (uint32_t i = 0; i < header->bodies; i++)
+    {
+        const EphemerisBody &b = bodies[i];
+        quint64 bytes = (quint64)b.blocks * 3 * b.coeffs * sizeof(double);
+        if (b.coeffs == 0 || b.span <= 0 || b.offset % sizeof(double) != 0 ||
+            b.offset < (quint64)table_end || b.offset + bytes > (quint64)size)
+        {
+            *error = filename + ": broken table of " + Name(i);
+            Close();
+            return false;
+        }
+    }
+    count = header->bodies;
+    return true;
+}
+
+void Ephemeris::Close()
+{
+    if (file)
+    {
+        if (data)
+            file->unmap((uchar *)data);
+        delete file;
+    }
+    file = nullptr;
+    data = nullptr;
+    bodies = nullptr;
+    count = 0;
+}
+
+bool Ephemeris::IsOpen() const
+{
+    return count > 0;
+}
+
+int Ephemeris::Bodies() const
+{
+    return count;
+}
+
+QString Ephemeris::Name(int body) const
+{
+    return QString::fromLatin1(bodies[body].name, strnlen(bodies[body].name, sizeof(bodies[body].name)));
+}
+
+int Ephemeris::Find(const QString &name) const
+{
+    for (int i = 0; i < count; i++)
+        if (Name(i).compare(name, Qt::CaseInsensitive) == 0)
+            return i;
+    return -1;
+}
+
+// days since start of the body table
+bool Ephemeris::Evaluate(int body, double days, double r[3]) const
+{
+    const EphemerisBody &b = bodies[body];
+    double k = floor(days / b.span);
+    if (k < 0 || k >= b.blocks)
+        return false;
+    double x = 2 * (days - k * b.span) / b.span - 1;
+    const double *block = (const double *)(data + b.offset) + (size_t)k * 3 * b.coeffs;
+    for (int i = 0; i < 3; i++)
+        r[i] = ChebyshevEval(block + i * b.coeffs, b.coeffs, x);
+    return true;
+}
+
+bool Ephemeris::PositionTDB(int body, double jd, double r[3]) const
+{
+    if (body < 0 || body >= count)
+        return false;
+    return Evaluate(body, jd - bodies[body].start, r);
+}
+
+bool Ephemeris::Position(int body, int64_t time, double r[3]) const
+{
+    if (body < 0 || body >= count)
+        return false;
+    // whole JD would lose tens of microseconds
+    double days = (Timebase::ToUTC(time) / 1e9 + tt_utc) / 86400;
+    return Evaluate(body, days + (jd_unix - bodies[body].start), r);
+}
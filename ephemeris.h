@@ -0,0 +1,69 @@
+#ifndef EPHEMERIS_H
+#define EPHEMERIS_H
+
+#include <QFile>
+#include <QString>
+#include <cstdint>
+
+/*
+ * Sun, Moon and planets from Chebyshev coefficient blocks.
+ *
+ * File is memory-mapped and read in place, one copy serves every mount.
+ * Layout, native byte order, made by ephemgen from JPL Horizons tables:
+ *
+ *   EphemerisHeader
+ *   EphemerisBody[bodies]
+ *   per body: blocks x (x, y, z) x coeffs doubles
+ *
+ * Positions are geocentric astrometric (light time corrected), ICRF,
+ * km. Block k covers [start + k * span, start + (k + 1) * span) of JD TDB.
+ */
+
+struct EphemerisHeader
+{
+    char magic[8];
+    uint32_t bodies;
+    uint32_t reserved;
+};
+
+struct EphemerisBody
+{
+    char name[16];
+    double start;       // JD TDB
+    double span;        // days
+    uint32_t coeffs;
+    uint32_t blocks;
+    uint64_t offset;    // from file start, bytes
+};
+
+static const char ephemeris_magic[8] = {'G', 'C', 'E', 'P', 'H', 'E', 'M', '1'};
+
+class Ephemeris
+{
+private:
+    QFile *file;
+    const uchar *data;
+    const EphemerisBody *bodies;
+    int count;
+private:
+    bool Evaluate(int body, double days, double r[3]) const;
+public:
+    Ephemeris();
+    ~Ephemeris();
+
+    bool Open(const QString &filename, QString *error);
+    void Close();
+    bool IsOpen() const;
+
+    int Bodies() const;
+    QString Name(int body) const;
+    // Case insensitive, -1 when missing
+    int Find(const QString &name) const;
+
+    // Timebase nanoseconds, false outside of covered time
+    bool Position(int body, int64_t time, double r[3]) const;
+    // Same at JD TDB
+    bool PositionTDB(int body, double jd, double r[3]) const;
+};
+
+#endif // EPHEMERIS_H
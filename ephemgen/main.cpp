@@ -0,0 +1,219 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QFile>
+#include <QTextStream>
+#include <QVector>
+#include <QDebug>
+#include <cmath>
+#include <cstring>
+#include "chebyshev.h"
+#include "ephemeris.h"
+
+/*
+ * Fits Chebyshev blocks to JPL Horizons vector tables.
+ *
+ * Every input file is one body: Horizons VECTORS table, center 500@399,
+ * ICRF, km, CSV format, with light time correction (VEC_CORR = LT).
+ * Step has to be small enough for interpolation, 1 h for the Moon,
+ * 6 h or less for the Sun and planets.
+ */
+
+struct Table
+{
+    QString name;
+    QVector<double> jd;
+    QVector<double> r[3];
+};
+
+struct Fit
+{
+    EphemerisBody body;
+    QVector<double> coeffs;
+    double error;       // km
+    double angle;       // arcsec
+};
+
+static bool ReadHorizons(const QString &filename, Table *table, QString *error)
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        *error = filename + ": " + file.errorString();
+        return false;
+    }
+    QTextStream in(&file);
+    bool data = false;
+    while (!in.atEnd())
+    {
+        QString line = in.readLine();
+        if (line.startsWith("Target body name:"))
+        {
+            QString name = line.mid(17).trimmed();
+            int end = name.indexOf(" (");
+            table->name = end > 0 ? name.left(end) : name.section(' ', 0, 0);
+        }
+        else if (line.startsWith("$$SOE"))
+            data = true;
+        else if (line.startsWith("$$EOE"))
+            break;
+        else if (data)
+        {
+            // JDTDB, calendar date, X, Y, Z, ...
+            QStringList f = line.split(',');
+            if (f.size() < 5)
+                continue;
+            table->jd.append(f[0].trimmed().toDouble());
+            for (int i = 0; i < 3; i++)
+                table->r[i].append(f[i + 2].trimmed().toDouble());
+        }
+    }
+    if (table->jd.size() < 8 || table->name.isEmpty())
+    {
+        *error = filename + ": no Horizons vector table";
+        return false;
+    }
+    return true;
+}
+
+// 8 point Lagrange interpolation on evenly spaced samples
+static double Interpolate(const QVector<double> &jd, const QVector<double> &v, double t)
+{
+    const int points = 8;
+    double step = jd[1] - jd[0];
+    int first = (int)floor((t - jd[0]) / step) - points / 2 + 1;
+    first = qBound(0, first, jd.size() - points);
+    double sum = 0;
+    for (int i = first; i < first + points; i++)
+    {
+        double w = 1;
+        for (int j = first; j < first + points; j++)
+            if (j != i)
+                w *= (t - jd[j]) / (jd[i] - jd[j]);
+        sum += w * v[i];
+    }
+    return sum;
+}
+
+static Fit FitTable(const Table &table, double span, int coeffs)
+{
+    Fit fit;
+    memset(&fit.body, 0, sizeof(fit.body));
+    strncpy(fit.body.name, table.name.toLatin1().constData(), sizeof(fit.body.name) - 1);
+    fit.body.start = table.jd.first();
+    fit.body.span = span;
+    fit.body.coeffs = coeffs;
+    fit.body.blocks = (uint32_t)floor((table.jd.last() - table.jd.first()) / span);
+
+    QVector<double> values(coeffs);
+    for (uint32_t k = 0; k < fit.body.blocks; k++)
+    {
+        double mid = fit.body.start + (k + 0.5) * span;
+        for (int i = 0; i < 3; i++)
+        {
+            for (int n = 0; n < coeffs; n++)
+                values[n] = Interpolate(table.jd, table.r[i], mid + ChebyshevNode(n, coeffs) * span / 2);
+            int base = fit.coeffs.size();
+            fit.coeffs.resize(base + coeffs);
+            ChebyshevFit(values.constData(), coeffs, fit.coeffs.data() + base);
+        }
+    }
+
+    // against every sample inside of blocks
+    fit.error = 0;
+    fit.angle = 0;
+    for (int s = 0; s < table.jd.size(); s++)
+    {
+        double days = table.jd[s] - fit.body.start;
+        int k = (int)floor(days / span);
+        if (k >= (int)fit.body.blocks)
+            break;
+        double x = 2 * (days - k * span) / span - 1;
+        double d2 = 0, r2 = 0;
+        for (int i = 0; i < 3; i++)
+        {
+            double v = ChebyshevEval(fit.coeffs.constData() + (k * 3 + i) * coeffs, coeffs, x);
+            d2 += (v - table.r[i][s]) * (v - table.r[i][s]);
+            r2 += table.r[i][s] * table.r[i][s];
+        }
+        fit.error = qMax(fit.error, sqrt(d2));
+        fit.angle = qMax(fit.angle, sqrt(d2 / r2) * 206264.806);
+    }
+    return fit;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("ephemgen");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Builds Chebyshev ephemeris file from JPL Horizons geocentric vector tables");
+    parser.addHelpOption();
+    QCommandLineOption outputOption(QStringList({"o", "output"}), "Ephemeris file to write.", "file", "bodies.eph");
+    QCommandLineOption spanOption("span", "Days covered by one block.", "days", "4");
+    QCommandLineOption coeffsOption("coeffs", "Coefficients per coordinate and block.", "n", "13");
+    parser.addOption(outputOption);
+    parser.addOption(spanOption);
+    parser.addOption(coeffsOption);
+    parser.addPositionalArgument("tables", "Horizons vector tables, one body per file.", "tables...");
+    parser.process(a);
+
+    double span = parser.value(spanOption).toDouble();
+    int coeffs = parser.value(coeffsOption).toInt();
+    if (parser.positionalArguments().isEmpty() || span <= 0 || coeffs < 2)
+        parser.showHelp(1);
+
+    QVector<Fit> fits;
+    for (const QString &filename : parser.positionalArguments())
+    {
+        Table table;
+        QString error;
+        if (!ReadHorizons(filename, &table, &error))
+        {
+            qCritical().noquote() << error;
+            return 1;
+        }
+        Fit fit = FitTable(table, span, coeffs);
+        if (fit.body.blocks == 0)
+        {
+            qCritical().noquote() << filename + ": table is shorter than one block";
+            return 1;
+        }
+        qInfo().noquote() << QString("%1: %2 blocks from JD %3, fit error %4 km, %5\"")
+                             .arg(table.name)
+                             .arg(fit.body.blocks)
+                             .arg(fit.body.start, 0, 'f', 1)
+                             .arg(fit.error, 0, 'g', 2)
+                             .arg(fit.angle, 0, 'g', 2);
+        fits.append(fit);
+    }
+
+    EphemerisHeader header;
+    memcpy(header.magic, ephemeris_magic, sizeof(header.magic));
+    header.bodies = fits.size();
+    header.reserved = 0;
+    uint64_t offset = sizeof(header) + fits.size() * sizeof(EphemerisBody);
+    for (Fit &fit : fits)
+    {
+        fit.body.offset = offset;
+        offset += fit.coeffs.size() * sizeof(double);
+    }
+
+    QFile out(parser.value(outputOption));
+    if (!out.open(QIODevice::WriteOnly))
+    {
+        qCritical().noquote() << out.fileName() + ":" << out.errorString();
+        return 1;
+    }
+    out.write((const char *)&header, sizeof(header));
+    for (const Fit &fit : fits)
+        out.write((const char *)&fit.body, sizeof(fit.body));
+    for (const Fit &fit : fits)
+        out.write((const char *)fit.coeffs.constData(), fit.coeffs.size() * sizeof(double));
+    if (!out.flush())
+    {
+        qCritical().noquote() << out.fileName() + ":" << out.errorString();
+        return 1;
+    }
+    return 0;
+}
@@ -1,43 +1,14 @@
-QT       += core gui serialport
-
-greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
-
-CONFIG += c++17
-
-# The following define makes your compiler emit warnings if you use
-# any Qt feature that has been marked deprecated (the exact warnings
-# depend on your compiler). Please consult the documentation of the
-# deprecated API in order to know how to port your code away from it.
-DEFINES += QT_DEPRECATED_WARNINGS
-
-# You can also make your code fail to compile if it uses deprecated APIs.
-# In order to do so, uncomment the following line.
-# You can also select to disable deprecated APIs only up to a certain version of Qt.
-#DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
-
-SOURCES += \
-    config.cpp \
-    coordinatesystem.cpp \
-    lx200server.cpp \
-    main.cpp \
-    mainwindow.cpp \
-    mountcontroller.cpp \
-    mountsystem.cpp \
-    tracker.cpp
-
-HEADERS += \
-    config.h \
-    coordinatesystem.h \
-    lx200server.h \
-    mainwindow.h \
-    mountcontroller.h \
-    mountsystem.h \
-    tracker.h
-
-FORMS += \
-    mainwindow.ui
-
-# Default rules for deployment.
-qnx: target.path = /tmp/$${TARGET}/bin
-else: unix:!android: target.path = /opt/$${TARGET}/bin
-!isEmpty(target.path): INSTALLS += target
+# core      gotocontrol-core static library, everything but widgets
+# gui       gotocontrol, Qt Widgets client
+# daemon    gotocontrold, headless client
+# mountsim  firmware simulator on a pseudo-terminal
+# simharness tracking scenarios in virtual time
+# ephemgen  ephemeris file from JPL Horizons tables
+TEMPLATE = subdirs
+
+SUBDIRS = core gui daemon mountsim simharness ephemgen
+
+gui.depends = core
+daemon.depends = core
+simharness.depends = core
+ephemgen.depends = core
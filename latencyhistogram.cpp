@@ -0,0 +1,85 @@
+#include "latencyhistogram.h"
+#include <cmath>
+
+LatencyHistogram::LatencyHistogram()
+{
+    Reset();
+}
+
+int LatencyHistogram::Index(uint64_t value)
+{
+    if (value >= (1ULL << max_bits))
+        return bucket_count - 1;
+    if (value < 2 * sub_count)
+        return value;
+    int msb = 63 - __builtin_clzll(value);
+    int shift = msb - sub_bits;
+    return (shift + 1) * sub_count + (int)(value >> shift) - sub_count;
+}
+
+uint64_t LatencyHistogram::Lower(int index)
+{
+    if (index < 2 * sub_count)
+        return index;
+    int shift = index / sub_count - 1;
+    return (uint64_t)(index % sub_count + sub_count) << shift;
+}
+
+void LatencyHistogram::Record(uint64_t value)
+{
+    buckets[Index(value)].fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(value, std::memory_order_relaxed);
+    uint64_t prev = max.load(std::memory_order_relaxed);
+    while (value > prev && !max.compare_exchange_weak(prev, value, std::memory_order_relaxed))
+        ;
+    // count goes last, so readers see buckets filled for it
+    count.fetch_add(1, std::memory_order_release);
+}
+
+void LatencyHistogram::Reset()
+{
+    for (int i = 0; i < bucket_count; i++)
+        buckets[i].store(0, std::memory_order_relaxed);
+    sum.store(0, std::memory_order_relaxed);
+    max.store(0, std::memory_order_relaxed);
+    count.store(0, std::memory_order_release);
+}
+
+uint64_t LatencyHistogram::Count() const
+{
+    return count.load(std::memory_order_acquire);
+}
+
+uint64_t LatencyHistogram::Max() const
+{
+    return max.load(std::memory_order_relaxed);
+}
+
+double LatencyHistogram::Mean() const
+{
+    uint64_t n = Count();
+    if (n == 0)
+        return 0;
+    return (double)sum.load(std::memory_order_relaxed) / n;
+}
+
+uint64_t LatencyHistogram::Percentile(double p) const
+{
+    uint64_t n = Count();
+    if (n == 0)
+        return 0;
+    uint64_t target = (uint64_t)std::ceil(p / 100 * n);
+    if (target < 1)
+        target = 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < bucket_count; i++)
+    {
+        seen += buckets[i].load(std::memory_order_relaxed);
+        if (seen >= target)
+        {
+            uint64_t upper = (i + 1 < bucket_count) ? Lower(i + 1) - 1 : Max();
+            return upper < Max() ? upper : Max();
+        }
+    }
+    return Max();
+}
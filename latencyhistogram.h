@@ -0,0 +1,42 @@
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <atomic>
+#include <cstdint>
+
+/*
+ * Log-linear histogram of durations in usec, HDR style.
+ *
+ * Each power of two is split into 16 linear buckets, so values are kept
+ * with ~6% precision up to 2^40 usec. Recording is lock-free, one writer
+ * is expected, readers may run in any thread.
+ */
+class LatencyHistogram
+{
+public:
+    static const int sub_bits = 4;
+    static const int sub_count = 1 << sub_bits;
+    static const int max_bits = 40;
+    static const int bucket_count = (max_bits - sub_bits + 1) * sub_count;
+private:
+    std::atomic<uint64_t> buckets[bucket_count];
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> sum;
+    std::atomic<uint64_t> max;
+private:
+    static int Index(uint64_t value);
+    static uint64_t Lower(int index);
+public:
+    LatencyHistogram();
+
+    void Record(uint64_t value);
+    void Reset();
+
+    uint64_t Count() const;
+    uint64_t Max() const;
+    double Mean() const;
+    // highest value of the bucket holding percentile p (0..100)
+    uint64_t Percentile(double p) const;
+};
+
+#endif // LATENCYHISTOGRAM_H
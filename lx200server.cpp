@@ -1,5 +1,8 @@
+#include <stdlib.h>
 #include "lx200server.h"
 
+static const QString ptmx = "/dev/ptmx";
+
 LX200Server::LX200Server(MountSystem *system, QSerialPort *port)
 {
     this->system = system;
@@ -12,6 +15,44 @@ LX200Server::~LX200Server()
     disconnect(port, SIGNAL(readyRead()), this, SLOT(Process()));
 }
 
+QSerialPort *LX200Server::OpenSerial(const QString &name, int baudrate, QString *error)
+{
+    QSerialPort *port = new QSerialPort();
+    port->setPortName(name);
+    port->setBaudRate(baudrate);
+    port->setParity(QSerialPort::Parity::NoParity);
+    port->setDataBits(QSerialPort::DataBits::Data8);
+    if (!port->open(QIODevice::ReadWrite))
+    {
+        delete port;
+        *error = "Can not open " + name;
+        return nullptr;
+    }
+    return port;
+}
+
+QSerialPort *LX200Server::OpenPty(int baudrate, QString *ptsname, QString *error)
+{
+    QSerialPort *port = OpenSerial(ptmx, baudrate, error);
+    if (!port)
+        return nullptr;
+
+    int master_fd = port->handle();
+    constexpr size_t PTSNAME_BUFFER_LENGTH = 128;
+    char ptsname_buffer[PTSNAME_BUFFER_LENGTH];
+    if (ptsname_r(master_fd, ptsname_buffer, PTSNAME_BUFFER_LENGTH) != 0 ||
+        grantpt(master_fd) != 0 ||
+        unlockpt(master_fd) != 0)
+    {
+        port->close();
+        delete port;
+        *error = "Can not handle " + ptmx;
+        return nullptr;
+    }
+    *ptsname = QString(ptsname_buffer);
+    return port;
+}
+
 void LX200Server::Process()
 {
     buf += port->readAll();
@@ -49,6 +90,26 @@ QString LX200Server::HandleCommand(const QString &cmd)
         int dec_s = abs(dec)*3600 - abs(dec_h)*3600 - abs(dec_m)*60;
         return QString().sprintf("%+03i*%02i:%02i#", dec_h, dec_m, dec_s);
     }
+    else if (cmd == ":TQ#")
+    {
+        system->SetTrackingRate(TrackingSidereal);
+        return "";
+    }
+    else if (cmd == ":TL#")
+    {
+        system->SetTrackingRate(TrackingLunar);
+        return "";
+    }
+    else if (cmd == ":TS#")
+    {
+        system->SetTrackingRate(TrackingSolar);
+        return "";
+    }
+    else if (cmd == ":TK#")
+    {
+        system->SetTrackingRate(TrackingKing);
+        return "";
+    }
     else if (cmd == ":Q#")
     {
         //system->SetSpeed_HA_Dec(system->siderial_sync_speed, 0);
@@ -2,6 +2,7 @@
 #define LX200SERVER_H
 
 #include <QObject>
+#include <QSerialPort>
 #include "mountsystem.h"
 
 class LX200Server : public QObject
@@ -19,6 +20,11 @@ private:
 public:
     LX200Server(MountSystem *system, QSerialPort *port);
     ~LX200Server();
+
+    // Ports to serve, nullptr and error text on failure
+    static QSerialPort *OpenSerial(const QString &name, int baudrate, QString *error);
+    // Pseudo terminal, clients open the slave side named in ptsname
+    static QSerialPort *OpenPty(int baudrate, QString *ptsname, QString *error);
 public slots:
     void Process();
 };
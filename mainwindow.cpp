@@ -1,7 +1,6 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 #include <QMessageBox>
-#include <QTimer>
 #include <QDebug>
 #include <QThread>
 #include <QSerialPortInfo>
@@ -12,56 +11,61 @@ MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow)
 {
-    timer = new QTimer(this);
-
-    connect(timer, SIGNAL(timeout()), this, SLOT(periodic_callback()));
-
     ui->setupUi(this);
     mountconnected = false;
     lx200port = nullptr;
     lx200running = false;
     system = nullptr;
-    mountport = nullptr;
-    period_dt = 0.5;
+    mount = new Mount(Config(), this);
+    connect(mount, SIGNAL(ticked()), this, SLOT(loop_ticked()), Qt::QueuedConnection);
+    connect(mount, SIGNAL(positionLost()), this, SLOT(position_lost()), Qt::QueuedConnection);
 }
 
 MainWindow::~MainWindow()
 {
-    disconnect(timer, SIGNAL(timeout()), this, SLOT(periodic_callback()));
-    delete timer;
+    if (mountconnected)
+        disconnect_port();
     delete ui;
 }
 
-void MainWindow::periodic_callback()
+void MainWindow::loop_ticked()
 {
-    read_position();
-    system->TrackingPeriodic(period_dt);
+    if (!ui->setPosition->isChecked() && !ui->gotoPosition->isChecked())
+    {
+        ShowPosition(true);
+    }
+}
+
+void MainWindow::position_lost()
+{
+    if (mountconnected)
+        disconnect_port();
 }
 
 void MainWindow::connect_port()
 {
-    try
-    {
-        Init();
-    }
-    catch (...)
+    QTimeZone tz = QTimeZone(ui->timezone->text().toLatin1());
+    double lon = ui->longitude->text().toDouble();
+    double lat = ui->latitude->text().toDouble();
+    int mountbaud = ui->mountbaud->currentText().toInt();
+    QString error;
+    if (!mount->Open(ui->mountport->text(), mountbaud, tz, lon, lat, &error))
     {
+        QMessageBox box;
+        box.setText(error);
+        box.exec();
         return;
     }
 
-    if (read_position())
-    {
-        ui->connect->setText("Disconnect");
-        mountconnected = true;
-
-        timer->start(period_dt*1000);
-        ui->lx200listen->setEnabled(true);
-    }
+    system = mount->System();
+    ui->connect->setText("Disconnect");
+    mountconnected = true;
+    ShowPosition(true);
+    ui->lx200listen->setEnabled(true);
 }
 
 void MainWindow::disconnect_port()
 {
-    timer->stop();
     mountconnected = false;
     ui->connect->setText("Connect");
     ui->lx200listen->setEnabled(false);
@@ -70,29 +74,8 @@ void MainWindow::disconnect_port()
     {
         stop_lx200_server();
     }
-    if (system)
-    {
-        delete system;
-        system = nullptr;
-    }
-    if (ctl)
-    {
-        delete ctl;
-        ctl = nullptr;
-    }
-    if (cs)
-    {
-        delete cs;
-        cs = nullptr;
-    }
-    if (mountport)
-    {
-        disconnect(mountport, SIGNAL(error(QSerialPort::SerialPortError)),this,SLOT(serialPortError(QSerialPort::SerialPortError)));
-        mountport->close();
-        delete mountport;
-        mountport = nullptr;
-    }
-
+    mount->Close();
+    system = nullptr;
 }
 
 void MainWindow::on_connect_clicked()
@@ -159,6 +142,8 @@ void MainWindow::ShowPosition(bool show_target)
         switch (std::get<0>(target))
         {
         case TrackerHoldHADec:
+        case TrackerHoldSatellite:
+        case TrackerHoldBody:
             ha_hms = ha_hms + " (" + toHMS(std::get<1>(target)) + ")";
             dec_dms = dec_dms + " (" + toDMS(std::get<2>(target)) + ")";
             break;
@@ -246,6 +231,46 @@ void MainWindow::on_setPosition_clicked(bool checked)
     }
 }
 
+void MainWindow::on_syncPoint_clicked()
+{
+    if (!mountconnected)
+        return;
+    bool ok = false;
+    if (ui->modeEQ->isChecked())
+    {
+        double dec = fromDMS(ui->posDEC->text());
+        if (ui->modeHA->isChecked())
+            ok = system->AddSyncPoint_HA_Dec(fromHMS(ui->posHA->text()), dec);
+        else if (ui->modeRA->isChecked())
+            ok = system->AddSyncPoint_RA_Dec(fromHMS(ui->posRA->text()), dec);
+    }
+    else if (ui->modeAZALT->isChecked())
+    {
+        double az = fromDMS(ui->posAZ->text());
+        double alt = fromDMS(ui->posALT->text());
+        ok = system->AddSyncPoint_Az_Alt(az, alt);
+    }
+    if (!ok)
+    {
+        ui->statusbar->showMessage("Can not read mount position");
+        return;
+    }
+
+    QString terms;
+    for (int i = 0; i < PointingTermCount; i++)
+        terms += QString(" %1=%2").arg(PointingModel::TermName(i)).arg(mount->Model()->Term(i), 0, 'f', 1);
+    ui->statusbar->showMessage(QString("Pointing model: %1 points, rms %2\"").arg(mount->Model()->Points()).arg(mount->Model()->RMS(), 0, 'f', 1) + terms);
+}
+
+void MainWindow::on_clearModel_clicked()
+{
+    if (mountconnected)
+    {
+        system->ClearPointingModel();
+        ui->statusbar->showMessage("Pointing model cleared");
+    }
+}
+
 void MainWindow::on_rotate_clicked(bool checked)
 {
     if (mountconnected)
@@ -253,10 +278,20 @@ void MainWindow::on_rotate_clicked(bool checked)
         if (!checked)
             system->StopTracking();
         else
+        {
+            system->SetTrackingRate((TrackingRate)ui->trackingRate->currentIndex());
             system->StartTracking_RA_Dec();
+        }
     }
 }
 
+void MainWindow::on_trackingRate_currentIndexChanged(int index)
+{
+    // combo box items follow TrackingRate order
+    if (mountconnected)
+        system->SetTrackingRate((TrackingRate)index);
+}
+
 void MainWindow::on_normalizeCS_clicked()
 {
     system->NormalizeCoordinates();
@@ -340,113 +375,27 @@ void MainWindow::on_lx200serial_toggled(bool checked)
     }
 }
 
-bool MainWindow::read_position()
-{
-    if (!system->ReadPosition())
-    {
-        disconnect_port();
-        return false;
-    }
-
-    if (!ui->setPosition->isChecked() && !ui->gotoPosition->isChecked())
-    {
-        ShowPosition(true);
-    }
-    return true;
-}
-
-void MainWindow::serialPortError(QSerialPort::SerialPortError error)
-{
-    if (error == QSerialPort::NoError)
-    {
-        return;
-    }
-    qWarning() << "Serial port error" << error;
-}
-
-void MainWindow::Init()
-{
-    mountport = new QSerialPort();
-    connect(mountport, SIGNAL(error(QSerialPort::SerialPortError)),this,SLOT(serialPortError(QSerialPort::SerialPortError)));
-    mountport->setPortName(ui->mountport->text());
-    mountport->setBaudRate(QSerialPort::Baud9600);
-    mountport->setParity(QSerialPort::NoParity);
-    mountport->setDataBits(QSerialPort::Data8);
-    mountport->setStopBits(QSerialPort::OneStop);
-    mountport->setFlowControl(QSerialPort::NoFlowControl);
-    if (!mountport->open(QIODevice::ReadWrite))
-    {
-        QMessageBox box;
-        box.setText("Can not open port");
-        box.exec();
-        throw "Can not open port";
-    }
-
-    QTimeZone tz = QTimeZone(ui->timezone->text().toLatin1());
-    double lon = ui->longitude->text().toDouble();
-    double lat = ui->latitude->text().toDouble();
-    cs = new CoordinateSystem(tz, lon, lat);
-    ctl = new MountController(mountport);
-    cfg = new Config();
-    tracker = new Tracker(cs, ctl, cfg);
-    system = new MountSystem(ctl, cs, tracker, cfg);
-}
-
 void MainWindow::start_lx200_server()
 {
     if (lx200port)
         lx200port->close();
+    int baudrate = ui->lx200baud->currentText().toInt();
+    QString error;
     if (ui->lx200serial->isChecked())
     {
-        lx200port = new QSerialPort(this);
-        lx200port->setPortName(ui->lx200port->text());
-        lx200port->setBaudRate(9600);
-        lx200port->setParity(QSerialPort::Parity::NoParity);
-        lx200port->setDataBits(QSerialPort::DataBits::Data8);
-        if (!lx200port->open(QIODevice::ReadWrite))
-        {
-            delete lx200port;
-            QMessageBox msg;
-            msg.setText("Can not listen serial port");
-            return;
-        }
+        lx200port = LX200Server::OpenSerial(ui->lx200port->text(), baudrate, &error);
     }
     else if (ui->lx200pty->isChecked())
     {
-        lx200port = new QSerialPort(this);
-        lx200port->setPortName(ptmx);
-        lx200port->setBaudRate(9600);
-        lx200port->setParity(QSerialPort::Parity::NoParity);
-        lx200port->setDataBits(QSerialPort::DataBits::Data8);
-        if (!lx200port->open(QIODevice::ReadWrite))
-        {
-            delete lx200port;
-            QMessageBox msg;
-            msg.setText("Can not open " + ptmx);
-            return;
-        }
-        int master_fd = lx200port->handle();
-        constexpr size_t PTSNAME_BUFFER_LENGTH = 128;
-        char ptsname_buffer[PTSNAME_BUFFER_LENGTH];
-        if (ptsname_r(master_fd, ptsname_buffer, PTSNAME_BUFFER_LENGTH) != 0 ||
-            grantpt(master_fd) != 0 ||
-            unlockpt(master_fd) != 0)
-        {
-            lx200port->close();
-            delete lx200port;
-            QMessageBox msg;
-            msg.setText("Can not handle " + ptmx);
-            return;
-        }
-
-        QString ptsname(ptsname_buffer);
-        /*QString fn = QDir::tempPath() + "/telescope";
-        if (QFile::exists(fn))
-        {
-            QFile::remove(fn);
-        }
-        QFile::link(ptsname, fn);*/
-        ui->lx200port->setText(ptsname);
+        QString ptsname;
+        lx200port = LX200Server::OpenPty(baudrate, &ptsname, &error);
+        if (lx200port)
+            ui->lx200port->setText(ptsname);
+    }
+    if (!lx200port)
+    {
+        ui->statusbar->showMessage(error);
+        return;
     }
     ui->lx200listen->setText("Stop");
     server = new LX200Server(system, lx200port);
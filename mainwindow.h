@@ -3,7 +3,7 @@
 
 #include <QButtonGroup>
 #include <QMainWindow>
-#include "mountsystem.h"
+#include "mount.h"
 #include "lx200server.h"
 
 QT_BEGIN_NAMESPACE
@@ -23,7 +23,10 @@ public slots:
     void on_disableSteppers_clicked();
     void on_gotoPosition_clicked(bool checked);
     void on_setPosition_clicked(bool checked);
+    void on_syncPoint_clicked();
+    void on_clearModel_clicked();
     void on_rotate_clicked(bool checked);
+    void on_trackingRate_currentIndexChanged(int index);
     void on_lx200listen_clicked();
     void on_lx200pty_toggled(bool checked);
     void on_lx200serial_toggled(bool checked);
@@ -36,33 +39,23 @@ public slots:
     void on_mountport_returnPressed();
     void on_lx200port_returnPressed();
 
-    bool read_position();
-    void periodic_callback();
-    void serialPortError(QSerialPort::SerialPortError error);
+    void loop_ticked();
+    void position_lost();
 private:
-    QTimer *timer;
     Ui::MainWindow *ui;
+    Mount *mount;
     MountSystem *system;
     LX200Server *server;
-    MountController *ctl;
-    CoordinateSystem *cs;
-    Tracker *tracker;
-    Config *cfg;
-    QSerialPort *mountport;
     QSerialPort *lx200port;
     bool mountconnected;
     bool lx200running;
     bool useSerial;
-    double period_dt;
 
 private:
     const int subseconds = 2;
-    const int baudrate = 9600;
-    const QString ptmx = "/dev/ptmx";
 private:
     void connect_port();
     void disconnect_port();
-    void Init();
     void start_lx200_server();
     void stop_lx200_server();
     QString toHMS(double x);
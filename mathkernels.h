@@ -0,0 +1,109 @@
+#ifndef MATHKERNELS_H
+#define MATHKERNELS_H
+
+#include <cmath>
+
+/*
+ * Branch-free double precision sin/cos and atan2 (Cephes polynomials).
+ *
+ * Inline, without library calls or data dependent branches, so loops over
+ * arrays calling them are vectorized by the compiler. Accuracy is about
+ * 1 ulp for the angle range used by coordinate conversions, sincos
+ * reduction is exact for |x| < 2^20.
+ */
+
+static inline double kernel_polevl5(double x, double c0, double c1, double c2, double c3, double c4, double c5)
+{
+    return ((((c0 * x + c1) * x + c2) * x + c3) * x + c4) * x + c5;
+}
+
+static inline void kernel_sincos(double x, double *s, double *c)
+{
+    const double FOPI = 1.27323954473516268615;
+    const double DP1 = 7.85398125648498535156E-1;
+    const double DP2 = 3.77489470793079817668E-8;
+    const double DP3 = 2.69515142907905952645E-15;
+
+    double sign_s = x < 0 ? -1.0 : 1.0;
+    x = x < 0 ? -x : x;
+
+    // octant, rounded up to even
+    int j = (int)(x * FOPI);
+    j = (j + 1) & ~1;
+    double y = j;
+    j = j & 7;
+
+    double z = ((x - y * DP1) - y * DP2) - y * DP3;
+    double zz = z * z;
+    double ps = z + z * zz * kernel_polevl5(zz,
+                                            1.58962301576546568060E-10,
+                                            -2.50507477628578072866E-8,
+                                            2.75573136213857245213E-6,
+                                            -1.98412698295895385996E-4,
+                                            8.33333333332211858878E-3,
+                                            -1.66666666666666307295E-1);
+    double pc = 1.0 - 0.5 * zz + zz * zz * kernel_polevl5(zz,
+                                                          -1.13585365213876817300E-11,
+                                                          2.08757008419747316778E-9,
+                                                          -2.75573141792967388112E-7,
+                                                          2.48015872888517045348E-5,
+                                                          -1.38888888888730564116E-3,
+                                                          4.16666666666665929218E-2);
+
+    // j is 0, 2, 4 or 6
+    bool swap = (j & 2) != 0;
+    double flip_s = (j & 4) ? -1.0 : 1.0;
+    double flip_c = ((j + 2) & 4) ? -1.0 : 1.0;
+    *s = sign_s * flip_s * (swap ? pc : ps);
+    *c = flip_c * (swap ? ps : pc);
+}
+
+static inline double kernel_atan(double x)
+{
+    const double T3P8 = 2.41421356237309504880;
+    const double MOREBITS = 6.123233995736765886130E-17;
+
+    double sign = x < 0 ? -1.0 : 1.0;
+    x = x < 0 ? -x : x;
+
+    bool big = x > T3P8;
+    bool mid = !big && x > 0.66;
+    double base = big ? M_PI_2 : (mid ? M_PI_4 : 0.0);
+    double more = big ? MOREBITS : (mid ? 0.5 * MOREBITS : 0.0);
+    // keep unused branches finite
+    double xb = big ? x : 1.0;
+    x = big ? -1.0 / xb : (mid ? (x - 1.0) / (x + 1.0) : x);
+
+    double z = x * x;
+    double p = (((-8.750608600031904122785E-1 * z
+                  - 1.615753718733365076637E1) * z
+                  - 7.500855792314704667340E1) * z
+                  - 1.228866684490136173410E2) * z
+                  - 6.485021904942025371773E1;
+    double q = ((((z + 2.485846490142306297962E1) * z
+                  + 1.650270098316988542046E2) * z
+                  + 4.328810604912902668951E2) * z
+                  + 4.853903996359136964868E2) * z
+                  + 1.945506571482613964425E2;
+    z = z * p / q;
+    z = x * z + x;
+    return sign * (base + (z + more));
+}
+
+static inline double kernel_atan2(double y, double x)
+{
+    double ax = x < 0 ? -x : x;
+    double ay = y < 0 ? -y : y;
+    // ratio never exceeds 1 in magnitude, atan of the smaller one
+    bool steep = ay > ax;
+    double num = steep ? x : y;
+    double den = steep ? y : x;
+    den = den == 0 ? 1.0 : den;
+    double a = kernel_atan(num / den);
+    double half = y < 0 ? -M_PI_2 : M_PI_2;
+    double r = steep ? half - a : a;
+    double full = y < 0 ? -M_PI : M_PI;
+    return (!steep && x < 0) ? r + full : r;
+}
+
+#endif // MATHKERNELS_H
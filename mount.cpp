@@ -0,0 +1,126 @@
+#include <QDebug>
+#include "mount.h"
+
+Mount::Mount(const Config &cfg, QObject *parent)
+    : QObject(parent), cfg(cfg)
+{
+    ctl = nullptr;
+    cs = nullptr;
+    model = nullptr;
+    tracker = nullptr;
+    system = nullptr;
+    loop = nullptr;
+    phase = 0;
+}
+
+Mount::~Mount()
+{
+    Close();
+}
+
+bool Mount::Open(const QString &port, int baudrate, const QTimeZone &tz,
+                 double longitude, double latitude, QString *error)
+{
+    Close();
+
+    ctl = new MountController(port, initial_baudrate);
+    if (!ctl->Open())
+    {
+        delete ctl;
+        ctl = nullptr;
+        *error = "Can not open port";
+        return false;
+    }
+    ctl->SetSnapshotMaxAge(cfg.position_max_age);
+    ctl->SetQueueSize(cfg.queue_size);
+    ctl->SetTelemetryInterval(cfg.telemetry_interval);
+    if (baudrate > initial_baudrate)
+        ctl->NegotiateBaudRate(baudrate);
+    if (cfg.binary_protocol)
+        ctl->NegotiateProtocol();
+
+    cs = new CoordinateSystem(tz, longitude, latitude);
+    cs->SetAstrometry(cfg.astrometry);
+    cs->SetAtmosphere(cfg.temperature, cfg.pressure);
+    tracker = new Tracker(cs, ctl, &cfg);
+    model = new PointingModel(latitude, name);
+    if (model->Load())
+        qInfo() << "Pointing model:" << model->Points() << "points, rms" << model->RMS() << "arcsec";
+    system = new MountSystem(ctl, cs, tracker, model, &cfg);
+
+    if (!system->ReadPosition())
+    {
+        Close();
+        *error = "Mount does not answer";
+        return false;
+    }
+
+    loop = new ControlLoop(ctl, system, cfg.control_rate, cfg.control_realtime, cfg.control_priority);
+    loop->SetPhase(phase);
+    connect(loop, SIGNAL(ticked()), this, SIGNAL(ticked()), Qt::DirectConnection);
+    connect(loop, SIGNAL(positionLost()), this, SIGNAL(positionLost()), Qt::DirectConnection);
+    loop->Start();
+    return true;
+}
+
+void Mount::Close()
+{
+    if (loop)
+    {
+        loop->Stop();
+        qDebug().noquote() << loop->Report();
+        delete loop;
+        loop = nullptr;
+    }
+    if (ctl)
+    {
+        qDebug() << "Position round-trips:" << ctl->PositionRoundTrips()
+                 << "saved:" << ctl->PositionRoundTripsSaved();
+        qDebug().noquote() << ctl->TelemetryReport();
+    }
+    delete system;
+    system = nullptr;
+    delete tracker;
+    tracker = nullptr;
+    delete model;
+    model = nullptr;
+    delete cs;
+    cs = nullptr;
+    delete ctl;
+    ctl = nullptr;
+}
+
+void Mount::SetPhase(double fraction)
+{
+    phase = fraction;
+}
+
+void Mount::SetName(const QString &name)
+{
+    this->name = name;
+}
+
+bool Mount::IsOpen()
+{
+    return loop != nullptr;
+}
+
+MountSystem *Mount::System()
+{
+    return system;
+}
+
+PointingModel *Mount::Model()
+{
+    return model;
+}
+
+MountController *Mount::Controller()
+{
+    return ctl;
+}
+
+ControlLoop *Mount::Loop()
+{
+    return loop;
+}
@@ -0,0 +1,60 @@
+#ifndef MOUNT_H
+#define MOUNT_H
+
+#include <QObject>
+#include <QTimeZone>
+#include "config.h"
+#include "coordinatesystem.h"
+#include "mountcontroller.h"
+#include "mountsystem.h"
+#include "pointingmodel.h"
+#include "tracker.h"
+#include "controlloop.h"
+
+/*
+ * Mount with everything it runs on: controller link, coordinate system,
+ * pointing model, tracker, MountSystem and control loop.
+ *
+ * GUI and daemon are its clients, they only choose the port and site.
+ */
+class Mount : public QObject
+{
+    Q_OBJECT
+private:
+    // link is opened at this rate, faster one is negotiated afterwards
+    const int initial_baudrate = 9600;
+private:
+    Config cfg;
+    QString name;
+    MountController *ctl;
+    CoordinateSystem *cs;
+    PointingModel *model;
+    Tracker *tracker;
+    MountSystem *system;
+    ControlLoop *loop;
+    double phase;
+public:
+    Mount(const Config &cfg, QObject *parent = nullptr);
+    ~Mount();
+
+    // Connects and starts tracking loop, error text on failure
+    bool Open(const QString &port, int baudrate, const QTimeZone &tz,
+              double longitude, double latitude, QString *error);
+    void Close();
+    // Control loop phase, fraction of its period, applied on next Open()
+    void SetPhase(double fraction);
+    // Registry name, keeps pointing model apart, applied on next Open()
+    void SetName(const QString &name);
+    bool IsOpen();
+
+    MountSystem *System();
+    PointingModel *Model();
+    MountController *Controller();
+    ControlLoop *Loop();
+signals:
+    // control loop updated position, emitted from its thread
+    void ticked();
+    void positionLost();
+};
+
+#endif // MOUNT_H
@@ -1,142 +1,413 @@
 #include "mountcontroller.h"
 #include <QDebug>
-#include <QThread>
+#include <QTimer>
+#include <climits>
 
-void MountController::send(const QString &cmd)
+static MountFrame makeFrame(uint8_t command, uint8_t seq, int a, int b, int c)
 {
-    QByteArray array = (cmd + "\r\n").toLatin1();
-    qDebug() << "Sending to port" << cmd;
-    port->write(array);
-    port->flush();
+    MountFrame frame;
+    frame.command = command;
+    frame.seq = seq;
+    frame.a = a;
+    frame.b = b;
+    frame.c = c;
+    return frame;
 }
 
-std::tuple<bool, QString> MountController::read()
+MountFrame MountController::CmdReadPosition()
 {
-    QByteArray buffer;
-    while (true)
+    return makeFrame('P', seq_next(), 0, 0, 0);
+}
+
+MountFrame MountController::CmdDisable()
+{
+    return makeFrame('D', seq_next(), 0, 0, 0);
+}
+
+MountFrame MountController::CmdVersion()
+{
+    return makeFrame('V', seq_next(), 0, 0, 0);
+}
+
+MountFrame MountController::CmdBaudRate(int rate)
+{
+    return makeFrame('B', seq_next(), rate, 0, 0);
+}
+
+MountFrame MountController::CmdGoto(int dx, int dy, int time)
+{
+    return makeFrame('G', tids.Next(), dx, dy, periods.Period(dx, dy, time));
+}
+
+MountFrame MountController::CmdSetPos(int x, int y)
+{
+    return makeFrame('S', seq_next(), x, y, 0);
+}
+
+int MountController::seq_next()
+{
+    seq = (seq + 1) & 0xFF;
+    return seq;
+}
+
+static const char *commandName(MountCommand command)
+{
+    switch (command)
     {
-        if (port->bytesAvailable() == 0)
-            port->waitForReadyRead(3000);
-        QByteArray data = port->readLine();
-        buffer.append(data);
-        if (buffer.length() == 0)
-            return std::make_tuple(false, "");
-        char last = buffer[buffer.length()-1];
-        if (last != '\n' && last != '\r')
-            continue;
-        QString line = QString::fromLatin1(buffer);
-        buffer.clear();
-        line.replace("\r","");
-        line.replace("\n","");
-        qDebug() << "Received" << line;
-        if (line.length() == 0 || line[0] == ':')
+    case MountCommandPosition:
+        return "P";
+    case MountCommandDisable:
+        return "D";
+    case MountCommandGoto:
+        return "G";
+    case MountCommandSetPosition:
+        return "S";
+    case MountCommandVersion:
+        return "V";
+    case MountCommandBaudRate:
+        return "B";
+    }
+    return "?";
+}
+
+static QString formatUsec(quint64 usec)
+{
+    return QString::number(usec / 1000.0, 'f', 1) + "ms";
+}
+
+void MountController::track_queue_space(int free)
+{
+    qint64 now = HostMonotonicTime();
+    if (free == 0 && no_space_since < 0)
+    {
+        no_space_since = now;
+    }
+    else if (free > 0 && no_space_since >= 0)
+    {
+        no_space.Record(now - no_space_since);
+        no_space_time += now - no_space_since;
+        no_space_since = -1;
+    }
+}
+
+MountController::MountController(const QString &portname, int baudrate, QObject *parent)
+    : QObject(parent)
+{
+    this->tag = 0;
+    this->seq = 0;
+    this->queue_size = 2;
+    snapshot.valid = false;
+    snapshot_generation = 0;
+    snapshot_max_age = 250;
+    position_round_trips = 0;
+    position_round_trips_saved = 0;
+    no_space_since = -1;
+    no_space_time = 0;
+    telemetry_last = HostMonotonicTime();
+    telemetry_last_sent = 0;
+    telemetry_last_received = 0;
+
+    telemetry_timer = new QTimer(this);
+    connect(telemetry_timer, SIGNAL(timeout()), this, SLOT(DumpTelemetry()));
+
+    thread = new QThread();
+    link = new MountLink(portname, baudrate);
+    link->SetMaxInFlight(queue_size + 2);
+    link->moveToThread(thread);
+    connect(link, SIGNAL(repliesReady()), this, SLOT(DrainReplies()));
+    thread->start();
+}
+
+MountController::~MountController()
+{
+    QMetaObject::invokeMethod(link, "Close", Qt::BlockingQueuedConnection);
+    thread->quit();
+    thread->wait();
+    delete link;
+    delete thread;
+}
+
+bool MountController::Open()
+{
+    bool ok = false;
+    QMetaObject::invokeMethod(link, "Open", Qt::BlockingQueuedConnection, Q_RETURN_ARG(bool, ok));
+    return ok;
+}
+
+int MountController::Push(MountCommand command, const MountFrame &frame, int timeout, bool wait)
+{
+    MountLink::Request req;
+    if (tag < INT_MAX)
+        tag = tag + 1;
+    else
+        tag = 1;
+    req.tag = tag;
+    req.command = command;
+    req.frame = frame;
+    req.timeout = timeout;
+    // S and D change position, replies to earlier P must not refresh the snapshot
+    if (command == MountCommandSetPosition || command == MountCommandDisable)
+    {
+        snapshot_generation++;
+        snapshot.valid = false;
+    }
+    req.generation = snapshot_generation;
+    if (command == MountCommandPosition)
+        position_round_trips++;
+    if (wait)
+        waiters.insert(req.tag);
+
+    if (!link->Send(req))
+    {
+        qWarning() << "Mount request ring is full";
+        MountLink::Reply reply;
+        reply.generation = req.generation;
+        reply.reply.tag = req.tag;
+        reply.reply.command = command;
+        reply.reply.ok = false;
+        reply.reply.tid = 0;
+        reply.reply.x = 0;
+        reply.reply.y = 0;
+        reply.reply.time = 0;
+        reply.arrived = 0;
+        reply.departed = 0;
+        reply.stamped = false;
+        reply.stamp = 0;
+        rejected.append(reply);
+        QTimer::singleShot(0, this, SLOT(DrainReplies()));
+        return req.tag;
+    }
+    outstanding.insert(req.tag);
+    return req.tag;
+}
+
+void MountController::DrainReplies()
+{
+    // ring has one consumer, replies are handled after it is released
+    // because handlers may block on other replies
+    QVector<MountLink::Reply> replies;
+    {
+        QMutexLocker locker(&drain_mutex);
+        MountLink::Reply reply;
+        while (link->Receive(&reply))
+            replies.append(reply);
+    }
+    {
+        QMutexLocker locker(&mutex);
+        replies += rejected;
+        rejected.clear();
+    }
+    for (const MountLink::Reply &reply : replies)
+        HandleReply(reply);
+}
+
+void MountController::HandleReply(const MountLink::Reply &reply)
+{
+    MountReply r = reply.reply;
+    {
+        QMutexLocker locker(&mutex);
+        outstanding.remove(r.tag);
+        // controller timestamp is better than the midpoint of the exchange
+        if (r.command == MountCommandPosition && r.ok && reply.stamped)
         {
-            continue;
+            qint64 stamp = sync.Unwrap(reply.stamp);
+            sync.AddSample(reply.arrived, reply.departed, stamp);
+            r.time = sync.ToHost(stamp);
+        }
+        if (r.command == MountCommandPosition && r.ok && reply.generation == snapshot_generation)
+        {
+            snapshot.valid = true;
+            snapshot.tid = r.tid;
+            snapshot.x = r.x;
+            snapshot.y = r.y;
+            snapshot.time = r.time;
         }
-        return std::make_tuple(true, line);
+        if (waiters.contains(r.tag))
+            results.insert(r.tag, r);
     }
+    if (r.command == MountCommandPosition)
+        emit positionReceived(r.tag, r.ok, r.tid, r.x, r.y, r.time);
+    emit commandFinished(r.tag, r.ok);
 }
 
-std::tuple<int, int, int> MountController::ParsePosition(const QString &state)
+MountReply MountController::Wait(int tag)
 {
-    QStringList items = state.split(" ");
-    int tid = items[0].toInt(nullptr, 8);
-    int x = items[1].toInt(nullptr, 8);
-    int y = items[2].toInt(nullptr, 8);
-    return std::make_tuple(tid, x, y);
+    QElapsedTimer timer;
+    timer.start();
+    while (true)
+    {
+        // taken before draining, a reply published in between is not slept over
+        quint64 generation = link->ReplyGeneration();
+        DrainReplies();
+        {
+            QMutexLocker locker(&mutex);
+            if (results.contains(tag) || !outstanding.contains(tag))
+                break;
+        }
+        // link answers every request, at worst with its timeout
+        if (timer.elapsed() > 2 * reply_timeout)
+            break;
+        link->WaitReply(generation, 100);
+    }
+
+    QMutexLocker locker(&mutex);
+    waiters.remove(tag);
+    if (results.contains(tag))
+        return results.take(tag);
+
+    MountReply reply;
+    reply.tag = tag;
+    reply.command = MountCommandPosition;
+    reply.ok = false;
+    reply.tid = 0;
+    reply.x = 0;
+    reply.y = 0;
+    reply.time = 0;
+    return reply;
 }
 
-QString MountController::CmdReadPosition()
+bool MountController::NegotiateProtocol()
 {
-    return "P";
+    int tag;
+    {
+        QMutexLocker locker(&mutex);
+        tag = Push(MountCommandVersion, CmdVersion(), handshake_timeout, true);
+    }
+    MountReply reply = Wait(tag);
+    MountProtocolMode protocol = link->Protocol();
+    qDebug() << "Mount protocol" << (protocol == MountProtocolBinary ? "binary" : "ASCII")
+             << "version" << (reply.ok ? reply.x : 1);
+    return protocol == MountProtocolBinary;
 }
 
-QString MountController::CmdDisable()
+MountProtocolMode MountController::Protocol()
 {
-    return "D";
+    return link->Protocol();
 }
 
-static QString toOctal(int x)
+bool MountController::Probe()
 {
-    QString s;
-    if (x < 0)
+    int tag;
     {
-        s = "-";
-        x = -x;
+        QMutexLocker locker(&mutex);
+        tag = Push(MountCommandPosition, CmdReadPosition(), handshake_timeout, true);
     }
-    return s + QString::number(x, 8);
+    return Wait(tag).ok;
 }
 
-QString MountController::CmdGoto(int dx, int dy, int time)
+bool MountController::NegotiateBaudRate(int rate)
 {
-    int period;
-    if (dx != 0 || dy != 0)
+    int current = link->BaudRate();
+    if (rate == current)
+        return true;
+
+    int tag;
     {
-        int steps;
-        if (abs(dx) > abs(dy))
-            steps = abs(dx);
-        else
-            steps = abs(dy);
-        period = time / steps;
+        QMutexLocker locker(&mutex);
+        tag = Push(MountCommandBaudRate, CmdBaudRate(rate), handshake_timeout, true);
     }
-    else
+    MountReply reply = Wait(tag);
+    if (!reply.ok)
     {
-        period = 100;
+        qDebug() << "Mount controller stays at" << current << "baud";
+        return false;
+    }
+
+    // link has switched with the confirmation, firmware keeps
+    // the new rate only when valid command comes
+    if (Probe())
+    {
+        qDebug() << "Mount controller switched to" << rate << "baud";
+        return true;
     }
 
-    return "G " + toOctal(tid_next()) + " " + toOctal(dx) + " " + toOctal(dy) + " " + toOctal(period);
+    qWarning() << "No reply at" << rate << "baud, falling back to" << current;
+    QMetaObject::invokeMethod(link, "SetBaudRate", Qt::BlockingQueuedConnection, Q_ARG(int, current));
+    QThread::msleep(baud_confirm_time);
+    Probe();
+    return false;
 }
 
-QString MountController::CmdSetPos(int x, int y)
+int MountController::BaudRate()
 {
-    return "S " + toOctal(x) + " " + toOctal(y);
+    return link->BaudRate();
 }
 
-int MountController::tid_next()
+int MountController::SendPosition(bool wait)
 {
-    if (tid < 128)
-        tid = tid+1;
-    else
-        tid = 1;
-    return tid;
+    QMutexLocker locker(&mutex);
+    return Push(MountCommandPosition, CmdReadPosition(), reply_timeout, wait);
+}
+
+int MountController::SendDisable(bool wait)
+{
+    QMutexLocker locker(&mutex);
+    periods.Reset();
+    tids.Disable();
+    return Push(MountCommandDisable, CmdDisable(), reply_timeout, wait);
+}
+
+int MountController::SendGoto(int dx, int dy, int time, bool wait)
+{
+    QMutexLocker locker(&mutex);
+    return Push(MountCommandGoto, CmdGoto(dx, dy, time), reply_timeout, wait);
 }
 
-int MountController::tid_delta(int t)
+int MountController::SendSetPosition(int x, int y, bool wait)
 {
-    t -= 1;
-    int tt = tid - 1;
-    if (tt < t)
-        tt += 128;
-    return tt - t;
+    QMutexLocker locker(&mutex);
+    periods.Reset();
+    return Push(MountCommandSetPosition, CmdSetPos(x, y), reply_timeout, wait);
 }
 
-int MountController::free_queue_lines(int t)
+int MountController::RequestPosition()
 {
-    if (t == 0)
-        return queue_size;
-    int delta = tid_delta(t);
-    return queue_size - delta - 1;
+    return SendPosition(false);
 }
 
-MountController::MountController(QSerialPort *port)
+int MountController::RequestDisable()
 {
-    this->tid = 1;
-    this->port = port;
+    return SendDisable(false);
 }
 
-std::tuple<bool, int, int, int> MountController::_ReadPosition()
+int MountController::RequestGoto(int dx, int dy, int time)
 {
-    mutex.lock();
-    send(CmdReadPosition());
-    std::tuple<bool, QString> ans = read();
-    mutex.unlock();
-    if (std::get<0>(ans) == false)
-        return std::make_tuple(false, 0, 0, 0);
-    std::tuple<int, int, int> state = ParsePosition(std::get<1>(ans));
-    int t = std::get<0>(state);
-    int x = std::get<1>(state);
-    int y = std::get<2>(state);
-    return std::make_tuple(true, t, x, y);
+    return SendGoto(dx, dy, time, false);
+}
+
+QVector<int> MountController::RequestGotoBatch(const QVector<MountSegment> &segments)
+{
+    // all segments are pushed at once, link writes them in a single write
+    QMutexLocker locker(&mutex);
+    QVector<int> tags;
+    for (const MountSegment &segment : segments)
+        tags.append(Push(MountCommandGoto, CmdGoto(segment.dx, segment.dy, segment.time), reply_timeout));
+    return tags;
+}
+
+int MountController::RequestSetPosition(int x, int y)
+{
+    return SendSetPosition(x, y, false);
+}
+
+int MountController::PendingRequests()
+{
+    QMutexLocker locker(&mutex);
+    return outstanding.size();
+}
+
+std::tuple<bool, int, int, int, qint64> MountController::_ReadPosition()
+{
+    {
+        QMutexLocker locker(&mutex);
+        if (snapshot.valid && HostMonotonicTime() - snapshot.time <= (qint64)snapshot_max_age * 1000)
+        {
+            position_round_trips_saved++;
+            return std::make_tuple(true, snapshot.tid, snapshot.x, snapshot.y, snapshot.time);
+        }
+    }
+    MountReply reply = Wait(SendPosition(true));
+    return std::make_tuple(reply.ok, reply.tid, reply.x, reply.y, reply.time);
 }
 
 std::tuple<bool, int, int> MountController::ReadPosition()
@@ -145,31 +416,28 @@ std::tuple<bool, int, int> MountController::ReadPosition()
     return std::make_tuple(std::get<0>(res), std::get<2>(res), std::get<3>(res));
 }
 
+std::tuple<bool, int, int, qint64> MountController::ReadPositionTimed()
+{
+    auto res = _ReadPosition();
+    return std::make_tuple(std::get<0>(res), std::get<2>(res), std::get<3>(res), std::get<4>(res));
+}
+
 void MountController::DisableSteppers()
 {
-    mutex.lock();
-    send(CmdDisable());
-    read();
-    mutex.unlock();
+    Wait(SendDisable(true));
 }
 
 bool MountController::Goto(int dx, int dy, int time)
 {
     if (!HasQueueSpace())
         return false;
-    mutex.lock();
-    send(CmdGoto(dx, dy, time));
-    read();
-    mutex.unlock();
+    Wait(SendGoto(dx, dy, time, true));
     return true;
 }
 
 void MountController::SetPosition(int x, int y)
 {
-    mutex.lock();
-    send(CmdSetPos(x, y));
-    read();
-    mutex.unlock();
+    Wait(SendSetPosition(x, y, true));
 }
 
 bool MountController::HasQueueSpace()
@@ -178,5 +446,175 @@ bool MountController::HasQueueSpace()
     if (std::get<0>(res) == false)
         return false;
 
-    return free_queue_lines(std::get<1>(res));
+    QMutexLocker locker(&mutex);
+    int free = tids.Free(std::get<1>(res), queue_size);
+    track_queue_space(free);
+    return free > 0;
+}
+
+int MountController::FreeQueueLines()
+{
+    auto res = _ReadPosition();
+    if (std::get<0>(res) == false)
+        return 0;
+
+    QMutexLocker locker(&mutex);
+    int free = tids.Free(std::get<1>(res), queue_size);
+    track_queue_space(free);
+    return free;
+}
+
+void MountController::SetQueueSize(int size)
+{
+    QMutexLocker locker(&mutex);
+    // tid distance must stay unambiguous
+    if (size < 1)
+        size = 1;
+    if (size > SegmentTids::count - 1)
+        size = SegmentTids::count - 1;
+    queue_size = size;
+    link->SetMaxInFlight(size + 2);
+}
+
+int MountController::QueueSize()
+{
+    QMutexLocker locker(&mutex);
+    return queue_size;
+}
+
+void MountController::SetSnapshotMaxAge(int msec)
+{
+    QMutexLocker locker(&mutex);
+    snapshot_max_age = msec;
+}
+
+void MountController::InvalidateSnapshot()
+{
+    QMutexLocker locker(&mutex);
+    snapshot.valid = false;
+}
+
+quint64 MountController::PositionRoundTrips()
+{
+    QMutexLocker locker(&mutex);
+    return position_round_trips;
+}
+
+quint64 MountController::PositionRoundTripsSaved()
+{
+    QMutexLocker locker(&mutex);
+    return position_round_trips_saved;
+}
+
+const LatencyHistogram &MountController::RoundTrip(MountCommand command)
+{
+    return link->Telemetry().round_trip[command];
+}
+
+const LatencyHistogram &MountController::NoQueueSpace()
+{
+    return no_space;
+}
+
+quint64 MountController::NoQueueSpaceTime()
+{
+    QMutexLocker locker(&mutex);
+    if (no_space_since >= 0)
+        return no_space_time + HostMonotonicTime() - no_space_since;
+    return no_space_time;
+}
+
+quint64 MountController::BytesSent()
+{
+    return link->Telemetry().bytes_sent.load(std::memory_order_relaxed);
+}
+
+quint64 MountController::BytesReceived()
+{
+    return link->Telemetry().bytes_received.load(std::memory_order_relaxed);
+}
+
+quint64 MountController::Timeouts()
+{
+    return link->Telemetry().timeouts.load(std::memory_order_relaxed);
+}
+
+bool MountController::ClockSynchronized()
+{
+    QMutexLocker locker(&mutex);
+    return sync.Synchronized();
+}
+
+double MountController::ClockOffset()
+{
+    QMutexLocker locker(&mutex);
+    return sync.Offset();
+}
+
+double MountController::ClockDrift()
+{
+    QMutexLocker locker(&mutex);
+    return sync.Drift();
+}
+
+QString MountController::TelemetryReport()
+{
+    QStringList lines;
+    for (int command = MountCommandPosition; command <= MountCommandBaudRate; command++)
+    {
+        const LatencyHistogram &h = RoundTrip((MountCommand)command);
+        if (h.Count() == 0)
+            continue;
+        lines.append(QString("%1: n=%2 p50=%3 p90=%4 p99=%5 max=%6")
+                     .arg(commandName((MountCommand)command))
+                     .arg((quint64)h.Count())
+                     .arg(formatUsec(h.Percentile(50)))
+                     .arg(formatUsec(h.Percentile(90)))
+                     .arg(formatUsec(h.Percentile(99)))
+                     .arg(formatUsec(h.Max())));
+    }
+
+    quint64 sent = BytesSent();
+    quint64 received = BytesReceived();
+    qint64 now = HostMonotonicTime();
+    double dt;
+    {
+        QMutexLocker locker(&mutex);
+        dt = (now - telemetry_last) / 1e6;
+        sent -= telemetry_last_sent;
+        received -= telemetry_last_received;
+        telemetry_last = now;
+        telemetry_last_sent += sent;
+        telemetry_last_received += received;
+    }
+    if (dt > 0)
+        lines.append(QString("link: tx %1 B/s rx %2 B/s timeouts %3")
+                     .arg(sent / dt, 0, 'f', 1)
+                     .arg(received / dt, 0, 'f', 1)
+                     .arg(Timeouts()));
+
+    if (ClockSynchronized())
+        lines.append(QString("clock: offset %1us drift %2ppm")
+                     .arg(ClockOffset(), 0, 'f', 0)
+                     .arg(ClockDrift(), 0, 'f', 2));
+
+    lines.append(QString("queue full: %1 total, %2 times, p50=%3 max=%4")
+                 .arg(formatUsec(NoQueueSpaceTime()))
+                 .arg((quint64)no_space.Count())
+                 .arg(formatUsec(no_space.Percentile(50)))
+                 .arg(formatUsec(no_space.Max())));
+    return lines.join("\n");
+}
+
+void MountController::SetTelemetryInterval(int msec)
+{
+    if (msec > 0)
+        telemetry_timer->start(msec);
+    else
+        telemetry_timer->stop();
+}
+
+void MountController::DumpTelemetry()
+{
+    qInfo().noquote() << "Mount telemetry\n" + TelemetryReport();
 }
@@ -1,39 +1,158 @@
 #ifndef MOUNTCONTROLLER_H
 #define MOUNTCONTROLLER_H
 
+#include <QObject>
 #include <QMutex>
-#include <QSerialPort>
+#include <QHash>
+#include <QSet>
+#include <QVector>
+#include <QThread>
+#include <QElapsedTimer>
+#include <QTimer>
+#include "mountlink.h"
+#include "mountdevice.h"
 
-class MountController
+class MountController : public QObject, public MountDevice
 {
+    Q_OBJECT
 private:
-    const int queue_size = 2;
+    struct PositionSnapshot
+    {
+        bool valid;
+        int tid;
+        int x;
+        int y;
+        qint64 time;    // host monotonic usec
+    };
 private:
-    int tid;
-    QSerialPort *port;
+    const int reply_timeout = 3000;
+    const int handshake_timeout = 500;
+    // firmware falls back to previous rate when no valid command comes in this time
+    const int baud_confirm_time = 1000;
+private:
+    int queue_size;
+    SegmentTids tids;
+    int tag;
+    int seq;
+    SegmentPeriods periods;
     QMutex mutex;
+    QMutex drain_mutex;
+
+    // serial port is owned by link running in its own thread
+    MountLink *link;
+    QThread *thread;
+
+    // requests sent to link and not answered yet
+    QSet<int> outstanding;
+    // requests that did not fit into the ring
+    QVector<MountLink::Reply> rejected;
+    // replies kept for blocking wrappers
+    QSet<int> waiters;
+    QHash<int, MountReply> results;
+
+    // last known position and queue state, refreshed by every position reply
+    PositionSnapshot snapshot;
+    ClockSync sync;
+    int snapshot_generation;
+    int snapshot_max_age;
+    quint64 position_round_trips;
+    quint64 position_round_trips_saved;
+
+    // stretches of time the motion queue was reported full, usec
+    LatencyHistogram no_space;
+    qint64 no_space_since;
+    quint64 no_space_time;
+
+    QTimer *telemetry_timer;
+    qint64 telemetry_last;
+    quint64 telemetry_last_sent;
+    quint64 telemetry_last_received;
 private:
-    void send(const QString &cmd);
-    std::tuple<bool, QString> read();
+    // with wait the reply is kept for Wait(), registered before it can arrive
+    int Push(MountCommand command, const MountFrame &frame, int timeout, bool wait = false);
+    void HandleReply(const MountLink::Reply &reply);
+    MountReply Wait(int tag);
 
-    int tid_next();
-    int tid_delta(int t);
-    int free_queue_lines(int t);
+    int SendPosition(bool wait);
+    int SendDisable(bool wait);
+    int SendGoto(int dx, int dy, int time, bool wait);
+    int SendSetPosition(int x, int y, bool wait);
 
-    std::tuple<int, int, int>  ParsePosition(const QString &state);
-    std::tuple<bool, int, int, int> _ReadPosition();
+    int seq_next();
+    void track_queue_space(int free);
 
-    QString CmdReadPosition();
-    QString CmdDisable();
-    QString CmdGoto(int dx, int dy, int period);
-    QString CmdSetPos(int x, int y);
+    std::tuple<bool, int, int, int, qint64> _ReadPosition();
+    bool Probe();
+
+    MountFrame CmdReadPosition();
+    MountFrame CmdDisable();
+    MountFrame CmdVersion();
+    MountFrame CmdBaudRate(int rate);
+    MountFrame CmdGoto(int dx, int dy, int period);
+    MountFrame CmdSetPos(int x, int y);
 public:
-    MountController(QSerialPort *port);
-    std::tuple<bool, int, int> ReadPosition();
-    void DisableSteppers();
+    MountController(const QString &portname, int baudrate, QObject *parent = nullptr);
+    ~MountController();
+
+    bool Open();
+
+    // Handshake at connect time, switches to binary protocol when firmware supports it
+    bool NegotiateProtocol();
+    MountProtocolMode Protocol();
+
+    // Asks firmware to switch to higher rate, stays at current one on failure
+    bool NegotiateBaudRate(int rate);
+    int BaudRate();
+
+    // Asynchronous API, returns request tag. Completion is reported by signals
+    int RequestPosition();
+    int RequestDisable();
+    int RequestGoto(int dx, int dy, int time) override;
+    QVector<int> RequestGotoBatch(const QVector<MountSegment> &segments) override;
+    int RequestSetPosition(int x, int y);
+    int PendingRequests();
+
+    // Blocking API
+    std::tuple<bool, int, int> ReadPosition() override;
+    // Position with its acquisition time, host monotonic usec
+    std::tuple<bool, int, int, qint64> ReadPositionTimed() override;
+    void DisableSteppers() override;
     bool Goto(int dx, int dy, int time);
-    void SetPosition(int x, int y);
+    void SetPosition(int x, int y) override;
     bool HasQueueSpace();
+    int FreeQueueLines() override;
+
+    // Depth of the controller motion queue
+    void SetQueueSize(int size);
+    int QueueSize();
+
+    // Position snapshot cache
+    void SetSnapshotMaxAge(int msec);
+    void InvalidateSnapshot();
+    quint64 PositionRoundTrips();
+    quint64 PositionRoundTripsSaved();
+
+    // Link telemetry, round-trip times are in usec
+    const LatencyHistogram &RoundTrip(MountCommand command);
+    const LatencyHistogram &NoQueueSpace();
+    quint64 NoQueueSpaceTime();
+    quint64 BytesSent();
+    quint64 BytesReceived();
+    quint64 Timeouts();
+    // Controller clock against host one, offset in usec and drift in ppm
+    bool ClockSynchronized();
+    double ClockOffset();
+    double ClockDrift();
+    // Rates are counted since the previous report
+    QString TelemetryReport();
+    // Dump report to log every msec, 0 disables
+    void SetTelemetryInterval(int msec);
+signals:
+    void positionReceived(int tag, bool ok, int tid, int x, int y, qint64 time);
+    void commandFinished(int tag, bool ok);
+private slots:
+    void DrainReplies();
+    void DumpTelemetry();
 };
 
 #endif // MOUNTCONTROLLER_H
@@ -0,0 +1,128 @@
+#ifndef MOUNTDEVICE_H
+#define MOUNTDEVICE_H
+
+#include <QVector>
+#include <cstdlib>
+#include <tuple>
+
+struct MountSegment
+{
+    int dx;
+    int dy;
+    int time;
+};
+
+/*
+ * Step periods of consecutive segments as firmware takes them, usec.
+ *
+ * Firmware runs a segment as steps * period, the part of segment time
+ * that does not divide evenly is carried to the next segment, so a long
+ * run of segments takes as long as the sum of their times.
+ */
+class SegmentPeriods
+{
+private:
+    int carry;
+public:
+    SegmentPeriods() : carry(0) {}
+
+    int Period(int dx, int dy, int time)
+    {
+        if (dx == 0 && dy == 0)
+            return 100;
+        int steps;
+        if (abs(dx) > abs(dy))
+            steps = abs(dx);
+        else
+            steps = abs(dy);
+        int total = time + carry;
+        int period = total / steps;
+        carry = total - period * steps;
+        return period;
+    }
+
+    // queue was dropped or position set, nothing to carry
+    void Reset()
+    {
+        carry = 0;
+    }
+};
+
+/*
+ * Free lines of the firmware motion queue from the tid it reports.
+ *
+ * Segments carry tids 1..count in turn, firmware reports the tid of
+ * the executing segment or of the last finished one. D drops the queue,
+ * firmware may go on reporting a dropped segment until it runs a new one.
+ */
+class SegmentTids
+{
+public:
+    static const int count = 128;
+private:
+    int tid;
+    // last tid sent before D, 0 once firmware reports a later one
+    int disabled;
+public:
+    SegmentTids() : tid(1), disabled(0) {}
+
+    int Next()
+    {
+        tid = tid % count + 1;
+        return tid;
+    }
+
+    // count of segments sent after the one with tid t
+    int Delta(int t) const
+    {
+        return ((tid - t) % count + count) % count;
+    }
+
+    // queue_size has to stay below count
+    int Free(int t, int queue_size)
+    {
+        if (t == 0)
+            return queue_size;
+        int delta = Delta(t);
+        if (disabled != 0)
+        {
+            // only segments sent after D are in the queue
+            int after = Delta(disabled);
+            if (delta >= after)
+                delta = after;
+            else
+                disabled = 0;
+        }
+        int free = queue_size - delta - 1;
+        if (free < 0)
+            return 0;
+        return free;
+    }
+
+    // D is sent, queue drops every segment sent so far
+    void Disable()
+    {
+        disabled = tid;
+    }
+};
+
+/*
+ * What MountSystem needs from the mount, implemented by MountController
+ * for the real one and by simulation harness for the virtual one.
+ */
+class MountDevice
+{
+public:
+    virtual ~MountDevice() {}
+
+    virtual std::tuple<bool, int, int> ReadPosition() = 0;
+    // Position with its acquisition time, host monotonic usec
+    virtual std::tuple<bool, int, int, qint64> ReadPositionTimed() = 0;
+    virtual void DisableSteppers() = 0;
+    virtual void SetPosition(int x, int y) = 0;
+    virtual int FreeQueueLines() = 0;
+    virtual int RequestGoto(int dx, int dy, int time) = 0;
+    virtual QVector<int> RequestGotoBatch(const QVector<MountSegment> &segments) = 0;
+};
+
+#endif // MOUNTDEVICE_H
@@ -0,0 +1,490 @@
+#include "mountlink.h"
+#include <QDebug>
+#include <QLoggingCategory>
+
+// per-command traffic, enable with QT_LOGGING_RULES="gotocontrol.mountlink.debug=true"
+Q_LOGGING_CATEGORY(mountlink, "gotocontrol.mountlink", QtInfoMsg)
+
+static uint8_t commandLetter(MountCommand command)
+{
+    switch (command)
+    {
+    case MountCommandPosition:
+        return 'P';
+    case MountCommandDisable:
+        return 'D';
+    case MountCommandGoto:
+        return 'G';
+    case MountCommandSetPosition:
+        return 'S';
+    case MountCommandVersion:
+        return 'V';
+    case MountCommandBaudRate:
+        return 'B';
+    }
+    return 0;
+}
+
+static QString toOctal(int x)
+{
+    QString s;
+    if (x < 0)
+    {
+        s = "-";
+        x = -x;
+    }
+    return s + QString::number(x, 8);
+}
+
+MountLink::MountLink(const QString &portname, int baudrate)
+{
+    this->portname = portname;
+    this->baudrate = baudrate;
+    port = nullptr;
+    watchdog = nullptr;
+    protocol = MountProtocolAscii;
+    max_in_flight = 4;
+    wakeup_pending = false;
+    replies_pending = false;
+    replied_generation = 0;
+    telemetry.bytes_sent = 0;
+    telemetry.bytes_received = 0;
+    telemetry.timeouts = 0;
+    received = 0;
+    last_stamp = 0;
+}
+
+MountLink::~MountLink()
+{
+}
+
+bool MountLink::Open()
+{
+    port = new QSerialPort(this);
+    connect(port, SIGNAL(error(QSerialPort::SerialPortError)), this, SLOT(PortError(QSerialPort::SerialPortError)));
+    port->setPortName(portname);
+    port->setBaudRate(baudrate);
+    port->setParity(QSerialPort::NoParity);
+    port->setDataBits(QSerialPort::Data8);
+    port->setStopBits(QSerialPort::OneStop);
+    port->setFlowControl(QSerialPort::NoFlowControl);
+    if (!port->open(QIODevice::ReadWrite))
+    {
+        delete port;
+        port = nullptr;
+        return false;
+    }
+    connect(port, SIGNAL(readyRead()), this, SLOT(ProcessReplies()));
+
+    watchdog = new QTimer(this);
+    connect(watchdog, SIGNAL(timeout()), this, SLOT(CheckTimeouts()));
+    watchdog->start(100);
+    return true;
+}
+
+void MountLink::Close()
+{
+    if (watchdog)
+    {
+        watchdog->stop();
+        delete watchdog;
+        watchdog = nullptr;
+    }
+    if (port)
+    {
+        port->close();
+        delete port;
+        port = nullptr;
+    }
+    FailInFlight();
+}
+
+void MountLink::PortError(QSerialPort::SerialPortError error)
+{
+    if (error == QSerialPort::NoError)
+        return;
+    qWarning() << "Serial port error" << error;
+}
+
+bool MountLink::Send(const Request &req)
+{
+    if (!tx.Push(req))
+        return false;
+    if (!wakeup_pending.exchange(true))
+        QMetaObject::invokeMethod(this, "Drain", Qt::QueuedConnection);
+    return true;
+}
+
+bool MountLink::Receive(Reply *reply)
+{
+    replies_pending = false;
+    return rx.Pop(reply);
+}
+
+quint64 MountLink::ReplyGeneration()
+{
+    QMutexLocker locker(&replied_mutex);
+    return replied_generation;
+}
+
+bool MountLink::WaitReply(quint64 generation, int msec)
+{
+    QMutexLocker locker(&replied_mutex);
+    if (replied_generation != generation)
+        return true;
+    return replied.wait(&replied_mutex, msec);
+}
+
+void MountLink::SetMaxInFlight(int count)
+{
+    max_in_flight = count;
+}
+
+MountProtocolMode MountLink::Protocol()
+{
+    return (MountProtocolMode)protocol.load();
+}
+
+int MountLink::BaudRate()
+{
+    return baudrate;
+}
+
+void MountLink::SetBaudRate(int rate)
+{
+    baudrate = rate;
+    reader.Clear();
+    if (port)
+    {
+        port->setBaudRate(rate);
+        port->clear(QSerialPort::Input);
+    }
+}
+
+const MountTelemetry &MountLink::Telemetry()
+{
+    return telemetry;
+}
+
+void MountLink::Drain()
+{
+    wakeup_pending = false;
+    Request req;
+    while (tx.Pop(&req))
+        backlog.enqueue(req);
+    Pump();
+}
+
+// nothing may share the wire with a rate change
+bool MountLink::Blocked()
+{
+    if (backlog.isEmpty())
+        return true;
+    if (in_flight.isEmpty())
+        return false;
+    if (backlog.head().command == MountCommandBaudRate)
+        return true;
+    return in_flight.last().request.command == MountCommandBaudRate;
+}
+
+void MountLink::Pump()
+{
+    if (port == nullptr)
+    {
+        while (!backlog.isEmpty())
+            Fail(backlog.dequeue());
+        return;
+    }
+
+    // several requests are written at once, the port is not flushed,
+    // data leaves with the I/O thread event loop
+    QByteArray data;
+    qint64 now = HostMonotonicTime();
+    while (!Blocked() && in_flight.size() < max_in_flight)
+    {
+        WireRequest wire;
+        wire.request = backlog.dequeue();
+        wire.sent = now;
+        // handshake reply is always ASCII
+        if (wire.request.command == MountCommandVersion)
+            protocol = MountProtocolAscii;
+        data.append(Serialize(wire.request.frame));
+        wire.arrived = now + data.length() * ByteTime();
+        in_flight.enqueue(wire);
+    }
+    if (data.length() > 0)
+    {
+        port->write(data);
+        telemetry.bytes_sent.fetch_add(data.length(), std::memory_order_relaxed);
+    }
+}
+
+// usec per byte with start and stop bits
+double MountLink::ByteTime()
+{
+    return 10 * 1e6 / baudrate;
+}
+
+QByteArray MountLink::Serialize(const MountFrame &frame)
+{
+    if (protocol == MountProtocolBinary && frame.command != 'V')
+    {
+        QByteArray data(mount_frame_size, 0);
+        MountFrameEncode(frame, (uint8_t *)data.data());
+        return data;
+    }
+
+    QString cmd;
+    switch (frame.command)
+    {
+    case 'G':
+        cmd = "G " + toOctal(frame.seq) + " " + toOctal(frame.a) + " " + toOctal(frame.b) + " " + toOctal(frame.c);
+        break;
+    case 'S':
+        cmd = "S " + toOctal(frame.a) + " " + toOctal(frame.b);
+        break;
+    case 'B':
+        cmd = "B " + toOctal(frame.a);
+        break;
+    default:
+        cmd = QString(QChar(frame.command));
+        break;
+    }
+    qCDebug(mountlink) << "Sending to port" << cmd;
+    return (cmd + "\r\n").toLatin1();
+}
+
+void MountLink::ProcessReplies()
+{
+    // bytes go from the port straight into the ring
+    received = HostMonotonicTime();
+    while (true)
+    {
+        int space;
+        char *buf = reader.WriteSpace(&space);
+        qint64 len = space > 0 ? port->read(buf, space) : 0;
+        if (len > 0)
+        {
+            reader.Commit(len);
+            telemetry.bytes_received.fetch_add(len, std::memory_order_relaxed);
+        }
+        while (ProcessReply())
+            ;
+        if (len <= 0 || port->bytesAvailable() == 0)
+            break;
+    }
+}
+
+bool MountLink::ProcessReply()
+{
+    if (protocol == MountProtocolBinary)
+    {
+        int len = mount_frame_size;
+        const char *data = reader.Peek(&len);
+        MountFrame frame;
+        bool valid;
+        int used = MountFrameDecode((const uint8_t *)data, len, &frame, &valid);
+        reader.Consume(used);
+        if (valid)
+            HandleFrame(frame);
+        return used > 0;
+    }
+
+    const char *line;
+    int len;
+    if (!reader.NextLine(&line, &len))
+        return false;
+    qCDebug(mountlink) << "Received" << QLatin1String(line, len);
+    HandleLine(line, len);
+    return true;
+}
+
+void MountLink::HandleLine(const char *line, int len)
+{
+    if (in_flight.isEmpty())
+    {
+        qWarning() << "Unexpected reply from mount" << QLatin1String(line, len);
+        return;
+    }
+
+    MountFrame frame;
+    frame.command = commandLetter(in_flight.head().request.command);
+    frame.seq = in_flight.head().request.frame.seq;
+    frame.a = 0;
+    frame.b = 0;
+    frame.c = 0;
+
+    bool ok = true;
+    qint64 stamp = -1;
+    if (frame.command == 'P')
+    {
+        // optional fourth field is controller time
+        int fields[4];
+        int count = ParseOctalFields(line, len, fields, 4);
+        ok = count >= 3;
+        if (ok)
+        {
+            frame.a = fields[0];
+            frame.b = fields[1];
+            frame.c = fields[2];
+        }
+        if (count == 4)
+            stamp = (quint32)fields[3];
+    }
+    else if (frame.command == 'V' || frame.command == 'B')
+    {
+        int value;
+        ok = len > 1 && line[0] == frame.command && ParseOctalFields(line + 1, len - 1, &value, 1) == 1;
+        if (ok)
+            frame.a = value;
+    }
+    else
+    {
+        // G, S, D echo their letter, "E" when firmware rejects the command
+        ok = !(len == 1 && line[0] == 'E');
+    }
+    HandleReply(frame, ok, len + 2, stamp);
+}
+
+void MountLink::HandleFrame(const MountFrame &frame)
+{
+    if (in_flight.isEmpty())
+    {
+        qWarning() << "Unexpected frame from mount" << frame.command << frame.seq;
+        return;
+    }
+    const Request &req = in_flight.head().request;
+    if (frame.seq != req.frame.seq || frame.command != commandLetter(req.command))
+    {
+        qWarning() << "Mount reply out of sequence" << frame.command << frame.seq;
+        FailInFlight();
+        return;
+    }
+    // rejected goto comes back with negative sequence echo
+    bool ok = !(frame.command == 'G' && frame.a < 0);
+    qint64 stamp = -1;
+    MountFrame reply = frame;
+    if (frame.command == 'P')
+    {
+        quint32 low = (quint32)frame.a >> 8;
+        quint32 time = (last_stamp & 0xFF000000u) | low;
+        if (time < last_stamp)
+            time += 1u << 24;
+        stamp = time;
+        reply.a = frame.a & 0xFF;
+    }
+    HandleReply(reply, ok, mount_frame_size, stamp);
+}
+
+void MountLink::HandleReply(const MountFrame &frame, bool ok, int bytes, qint64 stamp)
+{
+    WireRequest wire = in_flight.dequeue();
+    telemetry.round_trip[wire.request.command].Record(received - wire.sent);
+
+    Reply reply;
+    reply.generation = wire.request.generation;
+    reply.arrived = wire.arrived;
+    reply.departed = qMax(wire.arrived, received - (qint64)(bytes * ByteTime()));
+    reply.stamped = stamp >= 0;
+    reply.stamp = reply.stamped ? stamp : 0;
+    if (reply.stamped)
+        last_stamp = reply.stamp;
+    reply.reply.time = reply.arrived + (reply.departed - reply.arrived) / 2;
+    reply.reply.tag = wire.request.tag;
+    reply.reply.command = wire.request.command;
+    reply.reply.ok = ok;
+    reply.reply.tid = 0;
+    reply.reply.x = 0;
+    reply.reply.y = 0;
+    if (wire.request.command == MountCommandPosition)
+    {
+        reply.reply.tid = frame.a;
+        reply.reply.x = frame.b;
+        reply.reply.y = frame.c;
+    }
+    else if (wire.request.command == MountCommandVersion)
+    {
+        reply.reply.x = frame.a;
+        if (ok && frame.a >= mount_protocol_version)
+            protocol = MountProtocolBinary;
+    }
+    else if (wire.request.command == MountCommandBaudRate)
+    {
+        // firmware switches right after its confirmation
+        reply.reply.x = frame.a;
+        reply.reply.ok = ok && frame.a == wire.request.frame.a;
+        if (reply.reply.ok)
+            SetBaudRate(frame.a);
+    }
+    Publish(reply);
+    Pump();
+}
+
+void MountLink::Fail(const Request &req)
+{
+    Reply reply;
+    reply.generation = req.generation;
+    reply.arrived = 0;
+    reply.departed = 0;
+    reply.stamped = false;
+    reply.stamp = 0;
+    reply.reply.time = 0;
+    reply.reply.tag = req.tag;
+    reply.reply.command = req.command;
+    reply.reply.ok = false;
+    reply.reply.tid = 0;
+    reply.reply.x = 0;
+    reply.reply.y = 0;
+    Publish(reply);
+}
+
+void MountLink::FailInFlight()
+{
+    // replies are matched by order, so after a lost reply
+    // nothing that is already on the wire can be trusted
+    while (!in_flight.isEmpty())
+        Fail(in_flight.dequeue().request);
+    reader.Clear();
+    if (port)
+        port->clear(QSerialPort::Input);
+    Pump();
+}
+
+void MountLink::Publish(const Reply &reply)
+{
+    unpublished.enqueue(reply);
+    Flush();
+}
+
+void MountLink::Flush()
+{
+    bool published = false;
+    while (!unpublished.isEmpty() && rx.Push(unpublished.head()))
+    {
+        unpublished.dequeue();
+        published = true;
+    }
+    if (published)
+    {
+        QMutexLocker locker(&replied_mutex);
+        replied_generation++;
+        replied.wakeAll();
+    }
+    if (published && !replies_pending.exchange(true))
+        emit repliesReady();
+}
+
+void MountLink::CheckTimeouts()
+{
+    // results ring may have been full
+    Flush();
+
+    if (in_flight.isEmpty())
+        return;
+    const WireRequest &wire = in_flight.head();
+    if (HostMonotonicTime() - wire.sent < (qint64)wire.request.timeout * 1000)
+        return;
+    qWarning() << "Mount controller reply timeout";
+    telemetry.timeouts.fetch_add(1, std::memory_order_relaxed);
+    FailInFlight();
+}
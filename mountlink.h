@@ -0,0 +1,161 @@
+#ifndef MOUNTLINK_H
+#define MOUNTLINK_H
+
+#include <QObject>
+#include <QQueue>
+#include <QTimer>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QSerialPort>
+#include <atomic>
+#include "mountprotocol.h"
+#include "spscqueue.h"
+#include "replyreader.h"
+#include "latencyhistogram.h"
+#include "clocksync.h"
+
+enum MountCommand
+{
+    MountCommandPosition = 0,
+    MountCommandDisable,
+    MountCommandGoto,
+    MountCommandSetPosition,
+    MountCommandVersion,
+    MountCommandBaudRate,
+};
+
+enum MountProtocolMode
+{
+    MountProtocolAscii = 0,
+    MountProtocolBinary,
+};
+
+// filled by link thread, may be read from any thread
+struct MountTelemetry
+{
+    LatencyHistogram round_trip[MountCommandBaudRate + 1];
+    std::atomic<quint64> bytes_sent;
+    std::atomic<quint64> bytes_received;
+    std::atomic<quint64> timeouts;
+};
+
+struct MountReply
+{
+    int tag;
+    MountCommand command;
+    bool ok;
+    int tid;
+    int x;
+    int y;
+    // estimated time of acquisition, host monotonic usec
+    qint64 time;
+};
+
+/*
+ * Serial I/O thread of the mount controller.
+ *
+ * Owns the port and lives in its own QThread. Requests come from the
+ * controller through a lock-free ring, are written to the wire and
+ * matched with replies in order. Results go back through another ring.
+ * Ring ends are single producer / single consumer, controller side must
+ * be serialized by the caller.
+ */
+class MountLink : public QObject
+{
+    Q_OBJECT
+public:
+    struct Request
+    {
+        int tag;
+        MountCommand command;
+        MountFrame frame;
+        int timeout;
+        int generation;
+    };
+
+    struct Reply
+    {
+        MountReply reply;
+        int generation;
+        // request reached controller and reply left it, without line transmission
+        qint64 arrived;
+        qint64 departed;
+        // controller clock, usec, wraps at 32 bits
+        bool stamped;
+        quint32 stamp;
+    };
+private:
+    struct WireRequest
+    {
+        Request request;
+        qint64 sent;    // usec
+        qint64 arrived;
+    };
+private:
+    QString portname;
+    std::atomic<int> baudrate;
+    QSerialPort *port;
+    QTimer *watchdog;
+    qint64 received;
+    // last controller time, binary replies carry only its low 24 bits
+    quint32 last_stamp;
+    ReplyReader reader;
+    MountTelemetry telemetry;
+
+    // owned by I/O thread
+    QQueue<Request> backlog;
+    QQueue<WireRequest> in_flight;
+    QQueue<Reply> unpublished;
+
+    std::atomic<int> protocol;
+    std::atomic<int> max_in_flight;
+    std::atomic<bool> wakeup_pending;
+    std::atomic<bool> replies_pending;
+
+    SpscQueue<Request, 256> tx;
+    SpscQueue<Reply, 256> rx;
+    // bumped on every publish, blocking waiters sleep on it
+    QMutex replied_mutex;
+    QWaitCondition replied;
+    quint64 replied_generation;
+private:
+    void Pump();
+    bool Blocked();
+    QByteArray Serialize(const MountFrame &frame);
+    bool ProcessReply();
+    void HandleLine(const char *line, int len);
+    void HandleFrame(const MountFrame &frame);
+    void HandleReply(const MountFrame &frame, bool ok, int bytes, qint64 stamp);
+    double ByteTime();
+    void Fail(const Request &req);
+    void FailInFlight();
+    void Publish(const Reply &reply);
+    void Flush();
+public:
+    MountLink(const QString &portname, int baudrate);
+    ~MountLink();
+
+    // Called from controller thread
+    bool Send(const Request &req);
+    bool Receive(Reply *reply);
+    // Sleeps until replies are published after generation was taken
+    quint64 ReplyGeneration();
+    bool WaitReply(quint64 generation, int msec);
+    void SetMaxInFlight(int count);
+    MountProtocolMode Protocol();
+    int BaudRate();
+    const MountTelemetry &Telemetry();
+public slots:
+    bool Open();
+    void Close();
+    void SetBaudRate(int rate);
+private slots:
+    void Drain();
+    void ProcessReplies();
+    void CheckTimeouts();
+    void PortError(QSerialPort::SerialPortError error);
+signals:
+    void repliesReady();
+};
+
+#endif // MOUNTLINK_H
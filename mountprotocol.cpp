@@ -0,0 +1,76 @@
+#include "mountprotocol.h"
+
+uint16_t MountFrameCRC(const uint8_t *data, int len)
+{
+    uint16_t crc = 0xFFFF;
+    for (int i = 0; i < len; i++)
+    {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int j = 0; j < 8; j++)
+        {
+            if (crc & 0x8000)
+                crc = (crc << 1) ^ 0x1021;
+            else
+                crc = crc << 1;
+        }
+    }
+    return crc;
+}
+
+static void putInt32(uint8_t *buf, int32_t v)
+{
+    uint32_t u = (uint32_t)v;
+    buf[0] = u & 0xFF;
+    buf[1] = (u >> 8) & 0xFF;
+    buf[2] = (u >> 16) & 0xFF;
+    buf[3] = (u >> 24) & 0xFF;
+}
+
+static int32_t getInt32(const uint8_t *buf)
+{
+    uint32_t u = (uint32_t)buf[0] | ((uint32_t)buf[1] << 8) | ((uint32_t)buf[2] << 16) | ((uint32_t)buf[3] << 24);
+    return (int32_t)u;
+}
+
+void MountFrameEncode(const MountFrame &frame, uint8_t *buf)
+{
+    buf[0] = mount_frame_sync;
+    buf[1] = frame.command;
+    buf[2] = frame.seq;
+    putInt32(buf + 3, frame.a);
+    putInt32(buf + 7, frame.b);
+    putInt32(buf + 11, frame.c);
+    uint16_t crc = MountFrameCRC(buf, mount_frame_size - 2);
+    buf[15] = crc & 0xFF;
+    buf[16] = crc >> 8;
+}
+
+int MountFrameDecode(const uint8_t *buf, int len, MountFrame *frame, bool *valid)
+{
+    *valid = false;
+
+    // drop garbage before sync byte
+    int skip = 0;
+    while (skip < len && buf[skip] != mount_frame_sync)
+        skip++;
+    if (skip > 0)
+        return skip;
+
+    if (len < mount_frame_size)
+        return 0;
+
+    uint16_t crc = buf[15] | (buf[16] << 8);
+    if (crc != MountFrameCRC(buf, mount_frame_size - 2))
+    {
+        // false sync, search from next byte
+        return 1;
+    }
+
+    frame->command = buf[1];
+    frame->seq = buf[2];
+    frame->a = getInt32(buf + 3);
+    frame->b = getInt32(buf + 7);
+    frame->c = getInt32(buf + 11);
+    *valid = true;
+    return mount_frame_size;
+}
@@ -0,0 +1,52 @@
+#ifndef MOUNTPROTOCOL_H
+#define MOUNTPROTOCOL_H
+
+#include <cstdint>
+
+/*
+ * Binary protocol v2
+ *
+ * Every command and every reply is one fixed-size frame:
+ *
+ *  0       sync byte 0xA5
+ *  1       command letter, the same as in ASCII protocol ('P', 'D', 'G', 'S')
+ *  2       sequence id: tid for G, request counter for other commands.
+ *          Reply carries sequence id of its command
+ *  3..14   three int32 arguments, little-endian
+ *  15..16  CRC-16/CCITT of bytes 0..14, little-endian
+ *
+ *  command             reply
+ *  G dx, dy, period    tid, 0, 0
+ *  S x, y, 0           0, 0, 0
+ *  D 0, 0, 0           0, 0, 0
+ *  P 0, 0, 0           tid | time << 8, x, y
+ *
+ * Position reply carries low 24 bits of controller time in usec above
+ * tid, the same clock as the fourth field of ASCII one. Host extends it
+ * to 32 bits, so it has to ask for position at least every 16 s.
+ *
+ * Mode is selected by ASCII handshake: host sends "V", firmware with
+ * binary protocol support answers "V 2" and both sides switch to frames.
+ */
+
+const int mount_frame_size = 17;
+const uint8_t mount_frame_sync = 0xA5;
+const int mount_protocol_version = 2;
+
+struct MountFrame
+{
+    uint8_t command;
+    uint8_t seq;
+    int32_t a;
+    int32_t b;
+    int32_t c;
+};
+
+uint16_t MountFrameCRC(const uint8_t *data, int len);
+void MountFrameEncode(const MountFrame &frame, uint8_t *buf);
+
+// Returns number of consumed bytes, 0 if more data is needed.
+// *valid is set when frame with correct CRC was decoded to *frame
+int MountFrameDecode(const uint8_t *buf, int len, MountFrame *frame, bool *valid);
+
+#endif // MOUNTPROTOCOL_H
@@ -0,0 +1,155 @@
+#include <QDebug>
+#include "mountregistry.h"
+
+MountRegistry::MountRegistry(const Config &cfg, QObject *parent)
+    : QObject(parent), cfg(cfg)
+{
+}
+
+MountRegistry::~MountRegistry()
+{
+    Clear();
+}
+
+double MountRegistry::SlotPhase(int slot)
+{
+    // bit-reversed slot number, any count of first slots is spread
+    // over the period within a factor of two from evenly
+    double phase = 0;
+    double bit = 0.5;
+    for (; slot > 0; slot >>= 1, bit /= 2)
+    {
+        if (slot & 1)
+            phase += bit;
+    }
+    return phase;
+}
+
+int MountRegistry::FreeSlot()
+{
+    for (int slot = 0; ; slot++)
+    {
+        bool used = false;
+        for (const Entry &e : entries)
+        {
+            if (e.slot == slot)
+                used = true;
+        }
+        if (!used)
+            return slot;
+    }
+}
+
+int MountRegistry::Find(const QString &name)
+{
+    for (int i = 0; i < entries.size(); i++)
+    {
+        if (entries[i].settings.name == name)
+            return i;
+    }
+    return -1;
+}
+
+bool MountRegistry::Add(const Settings &settings, QString *error)
+{
+    if (Find(settings.name) != -1)
+    {
+        *error = "Mount " + settings.name + " already exists";
+        return false;
+    }
+
+    Entry e;
+    e.settings = settings;
+    e.slot = FreeSlot();
+    e.mount = new Mount(cfg, this);
+    e.mount->SetPhase(SlotPhase(e.slot));
+    e.mount->SetName(settings.name);
+    e.lx200port = nullptr;
+    e.server = nullptr;
+    if (!e.mount->Open(settings.port, settings.baudrate, QTimeZone(settings.timezone.toLatin1()),
+                       settings.longitude, settings.latitude, error))
+    {
+        delete e.mount;
+        return false;
+    }
+
+    if (settings.lx200 == "pty")
+        e.lx200port = LX200Server::OpenPty(settings.lx200_baudrate, &e.lx200name, error);
+    else if (!settings.lx200.isEmpty())
+    {
+        e.lx200port = LX200Server::OpenSerial(settings.lx200, settings.lx200_baudrate, error);
+        e.lx200name = settings.lx200;
+    }
+    if (!settings.lx200.isEmpty() && !e.lx200port)
+    {
+        delete e.mount;
+        return false;
+    }
+    if (e.lx200port)
+        e.server = new LX200Server(e.mount->System(), e.lx200port);
+
+    QString name = settings.name;
+    connect(e.mount, &Mount::positionLost, this, [this, name]() {
+        emit positionLost(name);
+    }, Qt::QueuedConnection);
+    entries.append(e);
+    return true;
+}
+
+void MountRegistry::Remove(const QString &name)
+{
+    int i = Find(name);
+    if (i == -1)
+        return;
+    Entry e = entries.takeAt(i);
+    // server goes first, it calls into the mount
+    delete e.server;
+    delete e.lx200port;
+    e.mount->Close();
+    delete e.mount;
+}
+
+void MountRegistry::Clear()
+{
+    while (!entries.isEmpty())
+        Remove(entries.last().settings.name);
+}
+
+int MountRegistry::Count()
+{
+    return entries.size();
+}
+
+QStringList MountRegistry::Names()
+{
+    QStringList names;
+    for (const Entry &e : entries)
+        names.append(e.settings.name);
+    return names;
+}
+
+Mount *MountRegistry::Get(const QString &name)
+{
+    int i = Find(name);
+    return i == -1 ? nullptr : entries[i].mount;
+}
+
+QString MountRegistry::LX200Endpoint(const QString &name)
+{
+    int i = Find(name);
+    return i == -1 ? QString() : entries[i].lx200name;
+}
+
+QString MountRegistry::Report()
+{
+    QStringList lines;
+    for (const Entry &e : entries)
+    {
+        ControlLoop *loop = e.mount->Loop();
+        QString line = QString("%1 (phase %2):").arg(e.settings.name).arg(SlotPhase(e.slot));
+        if (loop)
+            line += " " + loop->Report();
+        lines.append(line);
+    }
+    return lines.join("\n");
+}
@@ -0,0 +1,74 @@
+#ifndef MOUNTREGISTRY_H
+#define MOUNTREGISTRY_H
+
+#include <QObject>
+#include <QVector>
+#include <QStringList>
+#include <QSerialPort>
+#include "mount.h"
+#include "lx200server.h"
+
+/*
+ * Several mounts served by one process.
+ *
+ * Every mount has its own serial link thread and control loop thread,
+ * control loops tick at the same rate with phases spread over the
+ * period, so their wakeups and serial exchanges do not pile up at one
+ * moment when mounts are added. LX200 endpoints are served from the
+ * thread the registry lives in.
+ */
+class MountRegistry : public QObject
+{
+    Q_OBJECT
+public:
+    struct Settings
+    {
+        QString name;
+        QString port;
+        int baudrate;
+        QString timezone;
+        double longitude;
+        double latitude;
+        // serial port, "pty" for pseudo-terminal, empty for none
+        QString lx200;
+        int lx200_baudrate;
+    };
+private:
+    struct Entry
+    {
+        Settings settings;
+        int slot;
+        Mount *mount;
+        QSerialPort *lx200port;
+        LX200Server *server;
+        // where LX200 clients connect
+        QString lx200name;
+    };
+private:
+    Config cfg;
+    QVector<Entry> entries;
+private:
+    int FreeSlot();
+    int Find(const QString &name);
+public:
+    // Phase of control loop for a slot, 0, 1/2, 1/4, 3/4, 1/8 ...
+    static double SlotPhase(int slot);
+public:
+    MountRegistry(const Config &cfg, QObject *parent = nullptr);
+    ~MountRegistry();
+
+    // Opens mount and its LX200 endpoint, error text on failure
+    bool Add(const Settings &settings, QString *error);
+    void Remove(const QString &name);
+    void Clear();
+
+    int Count();
+    QStringList Names();
+    Mount *Get(const QString &name);
+    QString LX200Endpoint(const QString &name);
+    QString Report();
+signals:
+    void positionLost(const QString &name);
+};
+
+#endif // MOUNTREGISTRY_H
@@ -0,0 +1,43 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDebug>
+#include "mountsimulator.h"
+#include "ptysimulator.h"
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("mountsim");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Mount controller firmware simulator on a pseudo-terminal");
+    parser.addHelpOption();
+    QCommandLineOption queueOption("queue-size", "Motion queue depth.", "lines", "2");
+    QCommandLineOption latencyOption("latency", "Reply latency, ms.", "ms", "0");
+    QCommandLineOption jitterOption("jitter", "Reply latency jitter, ms.", "ms", "0");
+    QCommandLineOption baudOption("max-baud", "Highest baud rate firmware agrees to switch to.", "baud", "115200");
+    QCommandLineOption deadOption("dead-baud", "Baud rate the line can not carry, firmware has to fall back.", "baud", "0");
+    QCommandLineOption asciiOption("ascii-only", "Do not support binary protocol.");
+    parser.addOption(queueOption);
+    parser.addOption(latencyOption);
+    parser.addOption(jitterOption);
+    parser.addOption(baudOption);
+    parser.addOption(deadOption);
+    parser.addOption(asciiOption);
+    parser.process(a);
+
+    MountSimulator sim(parser.value(queueOption).toInt(),
+                       !parser.isSet(asciiOption),
+                       parser.value(baudOption).toInt());
+    PtySimulator pty(&sim,
+                     parser.value(latencyOption).toDouble() * 1000,
+                     parser.value(jitterOption).toDouble() * 1000);
+    pty.SetDeadBaudRate(parser.value(deadOption).toInt());
+    if (!pty.Open())
+    {
+        qCritical() << "Can not open pseudo-terminal";
+        return 1;
+    }
+    qInfo().noquote() << "Mount simulator on" << pty.SlaveName();
+    return a.exec();
+}
@@ -0,0 +1,22 @@
+QT       += core
+QT       -= gui
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = mountsim
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+INCLUDEPATH += ..
+
+SOURCES += \
+    ../mountprotocol.cpp \
+    ../mountsimulator.cpp \
+    main.cpp \
+    ptysimulator.cpp
+
+HEADERS += \
+    ../mountprotocol.h \
+    ../mountsimulator.h \
+    ptysimulator.h
@@ -0,0 +1,171 @@
+#include "ptysimulator.h"
+#include <QDebug>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+
+PtySimulator::PtySimulator(MountSimulator *sim, int latency, int jitter, QObject *parent)
+    : QObject(parent)
+{
+    this->sim = sim;
+    this->latency = latency;
+    this->jitter = jitter;
+    master_fd = -1;
+    slave_fd = -1;
+    notifier = nullptr;
+    timer = nullptr;
+    last_advance = 0;
+    line_free = 0;
+    dead_baudrate = 0;
+    random.seed(std::random_device()());
+    clock.start();
+}
+
+PtySimulator::~PtySimulator()
+{
+    if (slave_fd >= 0)
+        close(slave_fd);
+    if (master_fd >= 0)
+        close(master_fd);
+}
+
+bool PtySimulator::Open()
+{
+    master_fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master_fd < 0)
+        return false;
+    if (grantpt(master_fd) != 0 || unlockpt(master_fd) != 0)
+        return false;
+
+    constexpr size_t PTSNAME_BUFFER_LENGTH = 128;
+    char ptsname_buffer[PTSNAME_BUFFER_LENGTH];
+    if (ptsname_r(master_fd, ptsname_buffer, PTSNAME_BUFFER_LENGTH) != 0)
+        return false;
+    slave_name = QString(ptsname_buffer);
+
+    // keep slave side open, so master does not hang up when clients reconnect,
+    // and make it raw until a client configures it
+    slave_fd = open(ptsname_buffer, O_RDWR | O_NOCTTY);
+    if (slave_fd < 0)
+        return false;
+    struct termios tio;
+    tcgetattr(slave_fd, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(slave_fd, TCSANOW, &tio);
+
+    fcntl(master_fd, F_SETFL, fcntl(master_fd, F_GETFL) | O_NONBLOCK);
+    notifier = new QSocketNotifier(master_fd, QSocketNotifier::Read, this);
+    connect(notifier, SIGNAL(activated(int)), this, SLOT(Read()));
+
+    timer = new QTimer(this);
+    timer->setTimerType(Qt::PreciseTimer);
+    connect(timer, SIGNAL(timeout()), this, SLOT(Tick()));
+    timer->start(1);
+    return true;
+}
+
+QString PtySimulator::SlaveName()
+{
+    return slave_name;
+}
+
+void PtySimulator::SetDeadBaudRate(int rate)
+{
+    dead_baudrate = rate;
+}
+
+qint64 PtySimulator::Now()
+{
+    return clock.nsecsElapsed() / 1000;
+}
+
+void PtySimulator::Advance()
+{
+    qint64 now = Now();
+    sim->Advance(now - last_advance);
+    last_advance = now;
+}
+
+int PtySimulator::LineBaudRate()
+{
+    static const struct
+    {
+        speed_t speed;
+        int baudrate;
+    } rates[] = {
+        {B9600, 9600}, {B19200, 19200}, {B38400, 38400}, {B57600, 57600},
+        {B115200, 115200}, {B230400, 230400}, {B460800, 460800}, {B921600, 921600},
+    };
+
+    struct termios tio;
+    if (tcgetattr(slave_fd, &tio) != 0)
+        return 0;
+    speed_t speed = cfgetospeed(&tio);
+    for (const auto &rate : rates)
+        if (rate.speed == speed)
+            return rate.baudrate;
+    return 0;
+}
+
+bool PtySimulator::LineWorks(int baudrate)
+{
+    int line = LineBaudRate();
+    return line == baudrate && line != dead_baudrate;
+}
+
+void PtySimulator::Read()
+{
+    char buf[256];
+    ssize_t len;
+    Advance();
+    int baudrate = sim->BaudRate();
+    bool garbled = !LineWorks(baudrate);
+    while ((len = read(master_fd, buf, sizeof(buf))) > 0)
+    {
+        if (!garbled)
+            sim->Receive(QByteArray(buf, len));
+    }
+    if (garbled)
+        qDebug() << "Line rate mismatch, firmware is at" << baudrate;
+    Schedule(baudrate);
+}
+
+void PtySimulator::Schedule(int baudrate)
+{
+    QByteArray data = sim->TakeOutput();
+    if (data.isEmpty())
+        return;
+
+    qint64 delay = latency;
+    if (jitter > 0)
+    {
+        std::uniform_int_distribution<qint64> spread(-jitter, jitter);
+        delay += spread(random);
+    }
+
+    // replies leave in order, one after another on the emulated line
+    qint64 due = qMax(Now() + qMax(delay, (qint64)0), line_free);
+    due += (qint64)data.length() * 10 * 1000000 / baudrate;
+    line_free = due;
+
+    Pending reply;
+    reply.due = due;
+    reply.baudrate = baudrate;
+    reply.data = data;
+    pending.enqueue(reply);
+}
+
+void PtySimulator::Tick()
+{
+    Advance();
+    qint64 now = Now();
+    while (!pending.isEmpty() && pending.head().due <= now)
+    {
+        Pending reply = pending.dequeue();
+        if (!LineWorks(reply.baudrate))
+            continue;
+        if (write(master_fd, reply.data.constData(), reply.data.length()) < 0)
+            qWarning() << "Can not write to" << slave_name;
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef PTYSIMULATOR_H
+#define PTYSIMULATOR_H
+
+#include <QObject>
+#include <QQueue>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QSocketNotifier>
+#include <random>
+#include "mountsimulator.h"
+
+/*
+ * Exposes MountSimulator on a pseudo-terminal.
+ *
+ * Replies are delayed by latency with uniform jitter and by the
+ * transmission time at the firmware baud rate, their order is kept.
+ * Rate set by the client on its end of the terminal is compared with
+ * the firmware one, on mismatch data is lost in both directions.
+ * Dead rate loses data even when both ends agree, as a cable that
+ * can not carry it.
+ */
+class PtySimulator : public QObject
+{
+    Q_OBJECT
+private:
+    struct Pending
+    {
+        qint64 due;
+        int baudrate;
+        QByteArray data;
+    };
+private:
+    MountSimulator *sim;
+    int master_fd;
+    int slave_fd;
+    QString slave_name;
+    QSocketNotifier *notifier;
+    QTimer *timer;
+    QElapsedTimer clock;
+    std::mt19937 random;
+
+    // all times are in usec
+    qint64 last_advance;
+    qint64 latency;
+    qint64 jitter;
+    qint64 line_free;
+    int dead_baudrate;
+    QQueue<Pending> pending;
+private:
+    qint64 Now();
+    void Advance();
+    void Schedule(int baudrate);
+    int LineBaudRate();
+    bool LineWorks(int baudrate);
+public:
+    PtySimulator(MountSimulator *sim, int latency, int jitter, QObject *parent = nullptr);
+    ~PtySimulator();
+
+    // in the thread the simulator lives in
+    Q_INVOKABLE bool Open();
+    QString SlaveName();
+    void SetDeadBaudRate(int rate);
+private slots:
+    void Read();
+    void Tick();
+};
+
+#endif // PTYSIMULATOR_H
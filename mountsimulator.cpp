@@ -0,0 +1,326 @@
+#include "mountsimulator.h"
+#include <QStringList>
+#include <QVector>
+#include <QtGlobal>
+
+static QString toOctal(int x)
+{
+    QString s;
+    if (x < 0)
+    {
+        s = "-";
+        x = -x;
+    }
+    return s + QString::number(x, 8);
+}
+
+static MountFrame makeFrame(uint8_t command, uint8_t seq, int a, int b, int c)
+{
+    MountFrame frame;
+    frame.command = command;
+    frame.seq = seq;
+    frame.a = a;
+    frame.b = b;
+    frame.c = c;
+    return frame;
+}
+
+static const int standard_baudrates[] = {9600, 19200, 38400, 57600, 115200, 230400, 460800, 921600};
+
+MountSimulator::MountSimulator(int queue_size, bool binary_support, int max_baudrate)
+{
+    this->queue_size = queue_size;
+    this->binary_support = binary_support;
+    binary = false;
+    tid = 0;
+    last_tid = 0;
+    x = 0;
+    y = 0;
+    start_x = 0;
+    start_y = 0;
+    elapsed = 0;
+    now = 0;
+    this->max_baudrate = max_baudrate;
+    baudrate = 9600;
+    previous_baudrate = baudrate;
+    baud_confirm_left = -1;
+}
+
+void MountSimulator::Receive(const QByteArray &data)
+{
+    input.append(data);
+    while (input.length() > 0)
+    {
+        // handshake is always ASCII, frames never start with 'V'
+        if (binary && input[0] != 'V')
+        {
+            MountFrame frame;
+            bool valid;
+            int used = MountFrameDecode((const uint8_t *)input.constData(), input.length(), &frame, &valid);
+            if (used == 0)
+                return;
+            input.remove(0, used);
+            if (valid)
+                HandleFrame(frame);
+            continue;
+        }
+
+        int index = -1;
+        for (int i = 0; i < input.length(); i++)
+        {
+            if (input[i] == '\r' || input[i] == '\n')
+            {
+                index = i;
+                break;
+            }
+        }
+        if (index == -1)
+            return;
+        QString line = QString::fromLatin1(input.left(index));
+        input.remove(0, index + 1);
+        if (line.length() > 0)
+            HandleLine(line);
+    }
+}
+
+QByteArray MountSimulator::TakeOutput()
+{
+    QByteArray data = output;
+    output.clear();
+    return data;
+}
+
+void MountSimulator::Reply(const QString &line)
+{
+    output.append((line + "\r\n").toLatin1());
+}
+
+void MountSimulator::Reply(const MountFrame &frame)
+{
+    QByteArray data(mount_frame_size, 0);
+    MountFrameEncode(frame, (uint8_t *)data.data());
+    output.append(data);
+}
+
+void MountSimulator::HandleLine(const QString &line)
+{
+    QStringList items = line.split(" ");
+    QString cmd = items[0];
+    QVector<int> args;
+    for (int i = 1; i < items.size(); i++)
+        args.append(items[i].toInt(nullptr, 8));
+
+    if (cmd == "P" || cmd == "D" || cmd == "G" || cmd == "S" || cmd == "V")
+        Confirm();
+
+    if (cmd == "P")
+    {
+        Reply(toOctal(tid) + " " + toOctal(x) + " " + toOctal(y) + " " + QString::number((quint32)now, 8));
+    }
+    else if (cmd == "D")
+    {
+        Disable();
+        Reply("D");
+    }
+    else if (cmd == "G" && args.size() >= 4)
+    {
+        if (Enqueue(args[0], args[1], args[2], args[3]))
+            Reply("G " + toOctal(args[0]));
+        else
+            Reply("E");
+    }
+    else if (cmd == "S" && args.size() >= 2)
+    {
+        SetPosition(args[0], args[1]);
+        Reply("S");
+    }
+    else if (cmd == "B" && args.size() >= 1)
+    {
+        int current = baudrate;
+        if (SetBaudRate(args[0]))
+            Reply("B " + toOctal(args[0]));
+        else
+            Reply("B " + toOctal(current));
+    }
+    else if (cmd == "V")
+    {
+        if (binary_support)
+        {
+            Reply("V " + toOctal(mount_protocol_version));
+            binary = true;
+        }
+        else
+        {
+            binary = false;
+            Reply("E");
+        }
+    }
+    else
+    {
+        Reply("E");
+    }
+}
+
+void MountSimulator::HandleFrame(const MountFrame &frame)
+{
+    if (frame.command != 'B')
+        Confirm();
+
+    switch (frame.command)
+    {
+    case 'P':
+        Reply(makeFrame('P', frame.seq, (int32_t)((quint32)tid | (quint32)now << 8), x, y));
+        break;
+    case 'D':
+        Disable();
+        Reply(makeFrame('D', frame.seq, 0, 0, 0));
+        break;
+    case 'G':
+        if (Enqueue(frame.seq, frame.a, frame.b, frame.c))
+            Reply(makeFrame('G', frame.seq, frame.seq, 0, 0));
+        else
+            Reply(makeFrame('G', frame.seq, -1, 0, 0));
+        break;
+    case 'S':
+        SetPosition(frame.a, frame.b);
+        Reply(makeFrame('S', frame.seq, 0, 0, 0));
+        break;
+    case 'B':
+    {
+        int current = baudrate;
+        if (SetBaudRate(frame.a))
+            Reply(makeFrame('B', frame.seq, frame.a, 0, 0));
+        else
+            Reply(makeFrame('B', frame.seq, current, 0, 0));
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+// reply is sent with old rate, new one is used after it
+bool MountSimulator::SetBaudRate(int rate)
+{
+    bool supported = false;
+    for (int standard : standard_baudrates)
+        if (standard == rate && rate <= max_baudrate)
+            supported = true;
+    if (!supported)
+        return false;
+    if (rate != baudrate)
+    {
+        previous_baudrate = baudrate;
+        baudrate = rate;
+        baud_confirm_left = baud_confirm_time;
+    }
+    return true;
+}
+
+void MountSimulator::Confirm()
+{
+    baud_confirm_left = -1;
+}
+
+bool MountSimulator::Enqueue(int tid, int dx, int dy, int period)
+{
+    last_tid = tid;
+    if (queue.size() >= queue_size)
+        return false;
+    Segment segment;
+    segment.tid = tid;
+    segment.dx = dx;
+    segment.dy = dy;
+    segment.period = qMax(1, period);
+    queue.enqueue(segment);
+    if (queue.size() == 1)
+        StartSegment();
+    return true;
+}
+
+void MountSimulator::StartSegment()
+{
+    start_x = x;
+    start_y = y;
+    elapsed = 0;
+    if (!queue.isEmpty())
+        tid = queue.head().tid;
+}
+
+void MountSimulator::SetPosition(int x, int y)
+{
+    this->x = x;
+    this->y = y;
+    start_x = x;
+    start_y = y;
+}
+
+void MountSimulator::Disable()
+{
+    queue.clear();
+    StartSegment();
+    tid = last_tid;
+}
+
+void MountSimulator::Advance(qint64 usec)
+{
+    now += usec;
+    if (baud_confirm_left >= 0)
+    {
+        baud_confirm_left -= usec;
+        if (baud_confirm_left < 0)
+            baudrate = previous_baudrate;
+    }
+
+    while (usec > 0 && !queue.isEmpty())
+    {
+        const Segment &segment = queue.head();
+        qint64 steps = qMax(qAbs(segment.dx), qAbs(segment.dy));
+        qint64 duration = steps > 0 ? steps * segment.period : segment.period;
+        qint64 left = duration - elapsed;
+        if (usec < left)
+        {
+            elapsed += usec;
+            usec = 0;
+        }
+        else
+        {
+            elapsed = duration;
+            usec -= left;
+        }
+
+        // both axes make their steps evenly over the segment
+        qint64 done = qMin(steps, elapsed / segment.period);
+        if (steps > 0)
+        {
+            x = start_x + (qint64)segment.dx * done / steps;
+            y = start_y + (qint64)segment.dy * done / steps;
+        }
+
+        if (elapsed >= duration)
+        {
+            queue.dequeue();
+            StartSegment();
+        }
+    }
+}
+
+std::tuple<int, int, int> MountSimulator::Position()
+{
+    return std::make_tuple(tid, x, y);
+}
+
+int MountSimulator::QueueLength()
+{
+    return queue.size();
+}
+
+bool MountSimulator::BinaryMode()
+{
+    return binary;
+}
+
+int MountSimulator::BaudRate()
+{
+    return baudrate;
+}
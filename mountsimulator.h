@@ -0,0 +1,82 @@
+#ifndef MOUNTSIMULATOR_H
+#define MOUNTSIMULATOR_H
+
+#include <QByteArray>
+#include <QQueue>
+#include <QString>
+#include "mountprotocol.h"
+
+/*
+ * Host-side model of the stepper controller firmware.
+ *
+ * Speaks ASCII and binary (v2) protocols. Bytes from the host are passed
+ * to Receive(), replies are collected with TakeOutput(). Time is advanced
+ * explicitly with Advance(), segments are executed step by step with
+ * their periods, tid accounting follows the firmware: reported tid is
+ * the tid of the executing segment, or of the last finished one.
+ * D drops the queue as if it had run out: reported tid becomes the one
+ * of the last received segment.
+ *
+ * Position reply carries controller time in usec, as fourth field of
+ * ASCII one and above tid in binary one.
+ *
+ * Line rate changes with B command after the confirmation is sent and
+ * falls back when no valid command comes within baud_confirm_time.
+ */
+class MountSimulator
+{
+private:
+    struct Segment
+    {
+        int tid;
+        int dx;
+        int dy;
+        int period;
+    };
+private:
+    const qint64 baud_confirm_time = 1000000;
+private:
+    int queue_size;
+    bool binary_support;
+    bool binary;
+    int tid;
+    int last_tid;
+    int x;
+    int y;
+    // start of the executing segment and time spent in it, usec
+    int start_x;
+    int start_y;
+    qint64 elapsed;
+    qint64 now;
+    int max_baudrate;
+    int baudrate;
+    int previous_baudrate;
+    qint64 baud_confirm_left;
+    QQueue<Segment> queue;
+    QByteArray input;
+    QByteArray output;
+private:
+    void HandleLine(const QString &line);
+    void HandleFrame(const MountFrame &frame);
+    void Reply(const QString &line);
+    void Reply(const MountFrame &frame);
+    bool Enqueue(int tid, int dx, int dy, int period);
+    void SetPosition(int x, int y);
+    void Disable();
+    void StartSegment();
+    void Confirm();
+    bool SetBaudRate(int rate);
+public:
+    MountSimulator(int queue_size, bool binary_support, int max_baudrate = 9600);
+
+    void Receive(const QByteArray &data);
+    QByteArray TakeOutput();
+    void Advance(qint64 usec);
+
+    std::tuple<int, int, int> Position();
+    int QueueLength();
+    bool BinaryMode();
+    int BaudRate();
+};
+
+#endif // MOUNTSIMULATOR_H
@@ -1,49 +1,96 @@
 #include "mountsystem.h"
-#include "mountcontroller.h"
+#include "timebase.h"
+#include "chebyshev.h"
+#include <QThread>
 
-MountSystem::MountSystem(MountController *ctl, CoordinateSystem *cs, Tracker *tracker, Config *cfg)
+MountSystem::MountSystem(MountDevice *ctl, CoordinateSystem *cs, Tracker *tracker, PointingModel *model, Config *cfg)
+    : mutex(QMutex::Recursive)
 {
+    this->model = model;
     this->cs = cs;
     this->ctl = ctl;
     this->cfg = cfg;
     this->tracker = tracker;
     this->dec_invert = false;
+    tracking_rate = TrackingSidereal;
+    carry_x = carry_y = 0;
+    this->position_time = 0;
+
+    generator = nullptr;
+    generator_thread = nullptr;
+    path_posted = false;
+    path_restart = true;
+    path_dirty = false;
+    path_model = model->Generation();
+    path_end = 0;
+    if (cfg->lookahead > 0)
+    {
+        generator = new SegmentGenerator(ctl, (double)cfg->x_steps / cfg->x_rotation_time,
+                                         (double)cfg->y_steps / cfg->y_rotation_time);
+        if (cfg->lookahead_thread)
+        {
+            generator_thread = new QThread();
+            generator->moveToThread(generator_thread);
+            generator_thread->start();
+            QMetaObject::invokeMethod(generator, "Start", Qt::BlockingQueuedConnection);
+        }
+    }
+}
+
+MountSystem::~MountSystem()
+{
+    if (generator_thread)
+    {
+        QMetaObject::invokeMethod(generator, "Stop", Qt::BlockingQueuedConnection);
+        generator_thread->quit();
+        generator_thread->wait();
+        delete generator_thread;
+    }
+    delete generator;
+}
+
+void MountSystem::ProcessLookahead()
+{
+    QMutexLocker locker(&mutex);
+    if (generator && !generator_thread)
+        generator->Process();
 }
 
 void MountSystem::SetPosition_HA_Dec(double ha, double dec)
 {
+    QMutexLocker locker(&mutex);
     this->ha = ha;
     this->dec = dec;
-    this->ra = cs->Convert_HA2RA(ha, QDateTime::currentDateTime());
+    std::tie(this->ra, this->dec2000) = cs->Convert_HADec2RADec(ha, dec, Timebase::Now());
     tracker->Init_Track_HA_Dec(ha, dec);
     Set_HA_Dec(ha, dec);
 }
 
 void MountSystem::SetPosition_RA_Dec(double ra, double dec)
 {
+    QMutexLocker locker(&mutex);
     this->ra = ra;
-    this->dec = dec;
-    this->ha = cs->Convert_RA2HA(ra, QDateTime::currentDateTime());
+    this->dec2000 = dec;
+    std::tie(this->ha, this->dec) = cs->Convert_RADec2HADec(ra, dec, Timebase::Now());
     tracker->Init_Track_RA_Dec(ra, dec);
-    Set_HA_Dec(ha, dec);
+    Set_HA_Dec(this->ha, this->dec);
 }
 
 void MountSystem::SetPosition_Az_Alt(double az, double alt)
 {
+    QMutexLocker locker(&mutex);
     std::tuple<double, double> hadec = cs->Convert_from_Az_Alt(az, alt);
     this->az = az;
     this->alt = alt;
     this->ha = std::get<0>(hadec);
     this->dec = std::get<1>(hadec);
-    this->ra = cs->Convert_HA2RA(ha, QDateTime::currentDateTime());
+    std::tie(this->ra, this->dec2000) = cs->Convert_HADec2RADec(ha, dec, Timebase::Now());
     tracker->Init_Track_Az_Alt(az, alt);
     Set_HA_Dec(ha, dec);
 }
 
-std::tuple<int, int> MountSystem::Convert_To_XY(double ha, double dec)
+std::tuple<double, double> MountSystem::Convert_To_Steps(double ha, double dec)
 {
-    int x, y;
-
     if (dec_invert)
     {
         auto res = cs->Inverted_HA_Dec_Coordinates(ha, dec);
@@ -51,16 +98,22 @@ std::tuple<int, int> MountSystem::Convert_To_XY(double ha, double dec)
         dec = std::get<1>(res);
     }
 
-    x = ha/24 * cfg->x_steps;
-    y = dec/360 * cfg->y_steps + cfg->y_steps / 2;
+    auto m = model->ToMount(ha, dec);
+    ha = std::get<0>(m);
+    dec = std::get<1>(m);
+    double x = ha/24 * cfg->x_steps;
+    double y = dec/360 * cfg->y_steps + cfg->y_steps / 2;
     return std::make_tuple(x, y);
 }
 
-std::tuple<double, double> MountSystem::Convert_From_XY(int x, int y)
+std::tuple<double, double> MountSystem::Convert_From_Steps(double x, double y)
 {
     double ha = x * 24.0 / cfg->x_steps;
     double dec = (y - cfg->y_steps / 2) * 360.0 / cfg->y_steps;
 
+    auto m = model->FromMount(ha, dec);
+    ha = std::get<0>(m);
+    dec = std::get<1>(m);
     if (dec_invert)
     {
         auto res = cs->Inverted_HA_Dec_Coordinates(ha, dec);
@@ -70,18 +123,40 @@ std::tuple<double, double> MountSystem::Convert_From_XY(int x, int y)
     return std::make_tuple(ha, dec);
 }
 
+std::tuple<int, int> MountSystem::Convert_To_XY(double ha, double dec)
+{
+    auto r = Convert_To_Steps(ha, dec);
+    int x = qRound(std::get<0>(r));
+    int y = qRound(std::get<1>(r));
+    return std::make_tuple(x, y);
+}
+
+std::tuple<double, double> MountSystem::Convert_From_XY(int x, int y)
+{
+    return Convert_From_Steps(x, y);
+}
+
 bool MountSystem::Set_HA_Dec(double ha, double dec)
 {
     auto r = Convert_To_XY(ha, dec);
     int x = std::get<0>(r);
     int y = std::get<1>(r);
+    if (generator)
+        generator->Reset();
     ctl->SetPosition(x, y);
+    carry_x = carry_y = 0;
+    path_restart = true;
     return true;
 }
 
 std::tuple<bool, double, double> MountSystem::InitGoto()
 {
+    // segments precomputed for the old path must not follow D
+    if (generator)
+        generator->Reset();
     ctl->DisableSteppers();
+    carry_x = carry_y = 0;
+    path_restart = true;
 
     auto p = ctl->ReadPosition();
     if (!std::get<0>(p))
@@ -94,8 +169,68 @@ std::tuple<bool, double, double> MountSystem::InitGoto()
     return std::make_tuple(true, std::get<0>(r), std::get<1>(r));
 }
 
+bool MountSystem::AddSyncPoint(int x, int y, double ha, double dec)
+{
+    // axes position without model
+    double mount_ha = x * 24.0 / cfg->x_steps;
+    double mount_dec = (y - cfg->y_steps / 2) * 360.0 / cfg->y_steps;
+
+    // object on the same side of the pier as the axes
+    auto n = cs->Normalized_HA_Dec_Coordinates(ha, dec);
+    ha = std::get<1>(n);
+    dec = std::get<2>(n);
+    if (mount_dec > 90 || mount_dec < -90)
+    {
+        auto r = cs->Inverted_HA_Dec_Coordinates(ha, dec);
+        ha = std::get<0>(r);
+        dec = std::get<1>(r);
+    }
+    model->AddPoint(mount_ha, mount_dec, ha, dec);
+    path_dirty = true;
+    model->Save();
+    return true;
+}
+
+bool MountSystem::AddSyncPoint_HA_Dec(double ha, double dec)
+{
+    QMutexLocker locker(&mutex);
+    auto p = ctl->ReadPositionTimed();
+    if (!std::get<0>(p))
+        return false;
+    return AddSyncPoint(std::get<1>(p), std::get<2>(p), ha, dec);
+}
+
+bool MountSystem::AddSyncPoint_RA_Dec(double ra, double dec)
+{
+    QMutexLocker locker(&mutex);
+    auto p = ctl->ReadPositionTimed();
+    if (!std::get<0>(p))
+        return false;
+    auto hadec = cs->Convert_RADec2HADec(ra, dec, std::get<3>(p) * 1000);
+    return AddSyncPoint(std::get<1>(p), std::get<2>(p), std::get<0>(hadec), std::get<1>(hadec));
+}
+
+bool MountSystem::AddSyncPoint_Az_Alt(double az, double alt)
+{
+    QMutexLocker locker(&mutex);
+    auto p = ctl->ReadPositionTimed();
+    if (!std::get<0>(p))
+        return false;
+    auto hadec = cs->Convert_AzAlt2HADec(az, alt);
+    return AddSyncPoint(std::get<1>(p), std::get<2>(p), std::get<0>(hadec), std::get<1>(hadec));
+}
+
+void MountSystem::ClearPointingModel()
+{
+    QMutexLocker locker(&mutex);
+    model->Reset();
+    path_dirty = true;
+    model->Save();
+}
+
 void MountSystem::GotoPosition_HA_Dec(double ha, double dec)
 {
+    QMutexLocker locker(&mutex);
     std::tuple<bool, double, double> hadec = InitGoto();
     if (!std::get<0>(hadec))
         return;
@@ -105,16 +240,18 @@ void MountSystem::GotoPosition_HA_Dec(double ha, double dec)
 
 void MountSystem::GotoPosition_RA_Dec(double ra, double dec)
 {
+    QMutexLocker locker(&mutex);
     std::tuple<bool, double, double> hadec = InitGoto();
     if (!std::get<0>(hadec))
         return;
-    double curra = cs->Convert_HA2RA(std::get<1>(hadec), QDateTime::currentDateTime());
-    tracker->Init_Track_RA_Dec(curra, std::get<2>(hadec));
+    auto cur = cs->Convert_HADec2RADec(std::get<1>(hadec), std::get<2>(hadec), Timebase::Now());
+    tracker->Init_Track_RA_Dec(std::get<0>(cur), std::get<1>(cur));
     tracker->Set_Target_RA_Dec(ra, dec);
 }
 
 void MountSystem::GotoPosition_Az_Alt(double az, double alt)
 {
+    QMutexLocker locker(&mutex);
     std::tuple<bool, double, double> hadec = InitGoto();
     if (!std::get<0>(hadec))
         return;
@@ -123,28 +260,69 @@ void MountSystem::GotoPosition_Az_Alt(double az, double alt)
     tracker->Set_Target_Az_Alt(az, alt);
 }
 
+bool MountSystem::GotoSatellite(const TwoLineElements &tle)
+{
+    QMutexLocker locker(&mutex);
+    std::tuple<bool, double, double> hadec = InitGoto();
+    if (!std::get<0>(hadec))
+        return false;
+    tracker->Init_Track_HA_Dec(std::get<1>(hadec), std::get<2>(hadec));
+    if (!tracker->Set_Target_Satellite(tle))
+    {
+        tracker->StopTracking();
+        return false;
+    }
+    return true;
+}
+
+bool MountSystem::GotoBody(const Ephemeris *ephemeris, int body)
+{
+    QMutexLocker locker(&mutex);
+    std::tuple<bool, double, double> hadec = InitGoto();
+    if (!std::get<0>(hadec))
+        return false;
+    tracker->Init_Track_HA_Dec(std::get<1>(hadec), std::get<2>(hadec));
+    if (!tracker->Set_Target_Body(ephemeris, body))
+    {
+        tracker->StopTracking();
+        return false;
+    }
+    return true;
+}
+
+double MountSystem::ControlRate()
+{
+    QMutexLocker locker(&mutex);
+    return tracker->TrackingSatellite() ? cfg->satellite_rate : 0;
+}
+
 void MountSystem::SetDecAxisDirection(bool invert)
 {
+    QMutexLocker locker(&mutex);
     this->dec_invert = invert;
 }
 
 std::tuple<double, double> MountSystem::CurrentPosition_HA_Dec()
 {
+    QMutexLocker locker(&mutex);
     return std::make_tuple(ha, dec);
 }
 
 std::tuple<double, double> MountSystem::CurrentPosition_RA_Dec()
 {
-    return std::make_tuple(ra, dec);
+    QMutexLocker locker(&mutex);
+    return std::make_tuple(ra, dec2000);
 }
 
 std::tuple<double, double> MountSystem::CurrentPosition_Az_Alt()
 {
+    QMutexLocker locker(&mutex);
     return std::make_tuple(az, alt);
 }
 
 std::tuple<TrackerMode, double, double> MountSystem::CurrentTarget()
 {
+    QMutexLocker locker(&mutex);
     double a, b;
     auto mode = tracker->Get_Tracking_Target(&a, &b);
     return std::make_tuple(mode, a, b);
@@ -152,71 +330,272 @@ std::tuple<TrackerMode, double, double> MountSystem::CurrentTarget()
 
 bool MountSystem::ReadPosition()
 {
-    std::tuple<bool, int, int> r = ctl->ReadPosition();
+    QMutexLocker locker(&mutex);
+    std::tuple<bool, int, int, qint64> r = ctl->ReadPositionTimed();
     if (!std::get<0>(r))
         return false;
-    auto hadec = Convert_From_XY(std::get<1>(r), std::get<2>(r));
+    UpdatePosition(std::get<1>(r), std::get<2>(r), std::get<3>(r));
+    return true;
+}
+
+void MountSystem::UpdatePosition(int x, int y, qint64 time)
+{
+    QMutexLocker locker(&mutex);
+    // samples are stamped in usec on the same timebase
+    position_time = time * 1000;
+    auto hadec = Convert_From_XY(x, y);
     this->ha = std::get<0>(hadec);
     this->dec = std::get<1>(hadec);
-    this->ra = cs->Convert_HA2RA(this->ha, QDateTime::currentDateTime());
+    std::tie(this->ra, this->dec2000) = cs->Convert_HADec2RADec(this->ha, this->dec, position_time);
     std::tuple<double, double> azalt = cs->Convert_to_Az_Alt(this->ha, this->dec);
     this->az = std::get<0>(azalt);
     this->alt = std::get<1>(azalt);
-    return true;
+    // tracker continues from measured position, no fraction left
+    if (tracker->Sync(this->ha, this->dec, position_time))
+        carry_x = carry_y = 0;
 }
 
 bool MountSystem::DecAxisDirection()
 {
+    QMutexLocker locker(&mutex);
     return dec_invert;
 }
 
 void MountSystem::DisableSteppers()
 {
+    QMutexLocker locker(&mutex);
     ctl->DisableSteppers();
 }
 
 void MountSystem::NormalizeCoordinates()
 {
+    QMutexLocker locker(&mutex);
     if (dec > 90 || dec < -90)
         InvertCoordinates();
 }
 
 void MountSystem::InvertCoordinates()
 {
+    QMutexLocker locker(&mutex);
     SetDecAxisDirection(!dec_invert);
     tracker->InvertCoordinates();
+    path_dirty = true;
 }
 
 void MountSystem::StartTracking_RA_Dec()
 {
+    QMutexLocker locker(&mutex);
+    // motion goes on, no stop and restart of steppers
+    if (tracker->Tracking())
+        tracker->Hold_Point_RA_Dec();
+    else
+    {
+        auto radec = cs->Convert_HADec2RADec(ha, dec, Timebase::Now());
+        tracker->Init_Track_RA_Dec(std::get<0>(radec), std::get<1>(radec));
+    }
+    path_dirty = true;
+}
 
+void MountSystem::SetTrackingRate(TrackingRate rate, double dra, double ddec)
+{
+    QMutexLocker locker(&mutex);
+    // axis rate is sidereal minus RA drift
+    double speed = siderial_sync_speed;
+    switch (rate)
+    {
+    case TrackingLunar:
+        speed = lunar_speed;
+        break;
+    case TrackingSolar:
+        speed = solar_speed;
+        break;
+    case TrackingKing:
+        // King rate stands for refraction, astrometry models it already
+        if (!cfg->astrometry)
+            speed = king_speed;
+        break;
+    case TrackingCustom:
+        speed = siderial_sync_speed - dra;
+        break;
+    case TrackingSidereal:
+        break;
+    }
+    if (rate != TrackingCustom)
+        ddec = 0;
+    tracking_rate = rate;
+    tracker->Set_Rate((siderial_sync_speed - speed) / 3600 / 3600, ddec / 3600 / 3600);
+    path_dirty = true;
+}
+
+TrackingRate MountSystem::CurrentTrackingRate()
+{
+    QMutexLocker locker(&mutex);
+    return tracking_rate;
 }
 
 void MountSystem::StopTracking()
 {
+    QMutexLocker locker(&mutex);
     tracker->StopTracking();
 }
 
-void MountSystem::Move_HA_Dec(double dha, double ddec, double time)
+MountSegment MountSystem::Segment_HA_Dec(double dha, double ddec, double time)
 {
-    int dx = dha/24 * cfg->x_steps;
-    int dy = ddec/360 * cfg->y_steps;
+    double dx = dha/24 * cfg->x_steps;
+    double dy = ddec/360 * cfg->y_steps;
     if (dec_invert)
         dy = -dy;
-    ctl->Goto(dx, dy, time*1e6);
+    return Segment_Steps(dx, dy, time);
+}
+
+// segment between two sky points, through the pointing model
+MountSegment MountSystem::Segment_Points(std::tuple<double, double> from, std::tuple<double, double> to, double time)
+{
+    auto a = Convert_To_Steps(std::get<0>(from), std::get<1>(from));
+    auto b = Convert_To_Steps(std::get<0>(to), std::get<1>(to));
+    double dx = std::get<0>(b) - std::get<0>(a);
+    double dy = std::get<1>(b) - std::get<1>(a);
+    if (dx > cfg->x_steps / 2)
+        dx -= cfg->x_steps;
+    else if (dx < -cfg->x_steps / 2)
+        dx += cfg->x_steps;
+    return Segment_Steps(dx, dy, time);
+}
+
+// whole steps of the segment, the rest goes to the next one
+MountSegment MountSystem::Segment_Steps(double dx, double dy, double time)
+{
+    dx += carry_x;
+    dy += carry_y;
+    MountSegment segment;
+    segment.dx = qRound(dx);
+    segment.dy = qRound(dy);
+    segment.time = qRound64(time*1e6);
+    carry_x = dx - segment.dx;
+    carry_y = dy - segment.dy;
+    return segment;
+}
+
+void MountSystem::Move_HA_Dec(double dha, double ddec, double time)
+{
+    QMutexLocker locker(&mutex);
+    MountSegment segment = Segment_HA_Dec(dha, ddec, time);
+    ctl->RequestGoto(segment.dx, segment.dy, segment.time);
+}
+
+void MountSystem::PlanAhead(double dt)
+{
+    if (!tracker->Tracking())
+    {
+        if (path_posted)
+        {
+            SegmentPath stop;
+            stop.valid = false;
+            stop.restart = false;
+            generator->Post(stop);
+            path_posted = false;
+        }
+        return;
+    }
+
+    qint64 now = Timebase::Now();
+    // satellites move fast and unevenly, short segments refitted often
+    bool satellite = tracker->TrackingSatellite();
+    double lookahead = satellite ? cfg->satellite_lookahead : cfg->lookahead;
+    double segment_time = satellite ? cfg->satellite_segment_time : cfg->segment_time;
+    qint64 horizon = qRound64(lookahead * 1e9);
+    bool changed = tracker->TakeTargetChanged();
+    if (!changed && !path_restart && !path_dirty && path_posted &&
+        path_model == model->Generation() && path_end - now > horizon + horizon / 2)
+        return;
+
+    SegmentPath path;
+    path.valid = true;
+    path.restart = path_restart;
+
+    // continue from the end of segments already sent
+    auto end = generator->End();
+    double x = std::get<1>(end);
+    double y = std::get<2>(end);
+    qint64 start = qMax(now, std::get<3>(end));
+    if (path_restart || !std::get<0>(end))
+    {
+        auto p = ctl->ReadPositionTimed();
+        if (!std::get<0>(p))
+            return;
+        x = std::get<1>(p);
+        y = std::get<2>(p);
+        start = now;
+    }
+
+    if (changed)
+    {
+        auto from = Convert_From_Steps(x, y);
+        carry_x = carry_y = 0;
+        for (const SlewStep &s : tracker->Slew(std::get<0>(from), std::get<1>(from), start, dt))
+        {
+            auto to = std::make_tuple(std::get<0>(from) + s.dx, std::get<1>(from) + s.dy);
+            MountSegment segment = Segment_Points(from, to, s.time);
+            path.slew.append(segment);
+            x += segment.dx;
+            y += segment.dy;
+            start += segment.time * 1000LL;
+            from = to;
+        }
+    }
+
+    // target in axes over twice the horizon, x continuous from where we are
+    path.start = start;
+    path.end = start + 2 * horizon;
+    path.horizon = horizon;
+    path.segment_time = qRound(segment_time * 1e6);
+    double vx[SegmentPath::order], vy[SegmentPath::order];
+    double prev = x;
+    for (int k = 0; k < SegmentPath::order; k++)
+    {
+        double u = ChebyshevNode(k, SegmentPath::order);
+        qint64 t = path.start + qRound64((u + 1) / 2 * (path.end - path.start));
+        auto target = tracker->TargetAt(t);
+        auto steps = Convert_To_Steps(std::get<0>(target), std::get<1>(target));
+        double sx = std::get<0>(steps);
+        sx -= qRound((sx - prev) / cfg->x_steps) * (double)cfg->x_steps;
+        vx[k] = prev = sx;
+        vy[k] = std::get<1>(steps);
+    }
+    ChebyshevFit(vx, SegmentPath::order, path.x);
+    ChebyshevFit(vy, SegmentPath::order, path.y);
+    generator->Post(path);
+
+    path_posted = true;
+    path_restart = false;
+    path_dirty = false;
+    path_model = model->Generation();
+    path_end = path.end;
 }
 
 void MountSystem::TrackingPeriodic(double dt)
 {
-    if (!ctl->HasQueueSpace())
+    QMutexLocker locker(&mutex);
+    if (generator)
+    {
+        PlanAhead(dt);
         return;
+    }
 
-    auto res = tracker->ProcessTrack(dt);
-    double dha = std::get<0>(res);
-    double ddec = std::get<1>(res);
-    double dtime = std::get<2>(res);
-    if (dha != 0 || ddec != 0)
+    // fill all free queue lines with consecutive segments in one upload
+    int free = ctl->FreeQueueLines();
+    QVector<MountSegment> segments;
+    for (int i = 0; i < free; i++)
     {
-        Move_HA_Dec(dha, ddec, dtime);
+        auto from = tracker->Point();
+        auto res = tracker->ProcessTrack(dt);
+        double dha = std::get<0>(res);
+        double ddec = std::get<1>(res);
+        double dtime = std::get<2>(res);
+        if (dha == 0 && ddec == 0)
+            break;
+        segments.append(Segment_Points(from, tracker->Point(), dtime));
     }
+    if (!segments.isEmpty())
+        ctl->RequestGotoBatch(segments);
 }
@@ -1,42 +1,97 @@
 #ifndef SYSTEM_H
 #define SYSTEM_H
 
+#include <QMutex>
 #include "coordinatesystem.h"
-#include "mountcontroller.h"
+#include "mountdevice.h"
 #include "config.h"
 #include "tracker.h"
+#include "pointingmodel.h"
+#include "segmentgenerator.h"
+
+enum TrackingRate
+{
+    TrackingSidereal = 0,
+    TrackingLunar,
+    TrackingSolar,
+    TrackingKing,
+    TrackingCustom,
+};
 
 class MountSystem
 {
 private:
+    // public calls come from control loop, GUI and LX200 server threads
+    QMutex mutex;
     Config *cfg;
-    MountController *ctl;
+    MountDevice *ctl;
     CoordinateSystem *cs;
     Tracker *tracker;
+    PointingModel *model;
     double ha;
-    double ra;
     double dec;
+    // catalog J2000 position
+    double ra;
+    double dec2000;
     double az;
     double alt;
     bool dec_invert;
+    TrackingRate tracking_rate;
     double target_x, target_y;
+    // fractions of step not sent yet, carried to next segment
+    double carry_x, carry_y;
+    // acquisition time of the last position read from mount, Timebase nsec
+    qint64 position_time;
+
+    // lookahead generation, null when tracking runs from TrackingPeriodic
+    SegmentGenerator *generator;
+    QThread *generator_thread;
+    bool path_posted;
+    bool path_restart;
+    bool path_dirty;
+    int path_model;
+    qint64 path_end;
 private:
     std::tuple<bool, double, double> InitGoto();
     bool Set_HA_Dec(double ha, double dec);
     std::tuple<int, int> Convert_To_XY(double ha, double dec);
     std::tuple<double, double> Convert_From_XY(int x, int y);
+    std::tuple<double, double> Convert_To_Steps(double ha, double dec);
+    std::tuple<double, double> Convert_From_Steps(double x, double y);
+    void PlanAhead(double dt);
+    MountSegment Segment_HA_Dec(double dha, double ddec, double time);
+    MountSegment Segment_Points(std::tuple<double, double> from, std::tuple<double, double> to, double time);
+    MountSegment Segment_Steps(double dx, double dy, double time);
+    bool AddSyncPoint(int x, int y, double ha, double dec);
 public:
+    // hour angle axis rates, seconds of HA per hour
     const double siderial_sync_speed = 86400 / 86164.090530833 * 3600;
+    // mean Moon goes round RA in sidereal month
+    const double lunar_speed = siderial_sync_speed - 3600 / 27.321661;
+    const double solar_speed = 3600;
+    const double king_speed = 15.0369 / 15 * 3600;
 public:
-    MountSystem(MountController *ctl, CoordinateSystem *cs, Tracker *tracker, Config *cfg);
+    MountSystem(MountDevice *ctl, CoordinateSystem *cs, Tracker *tracker, PointingModel *model, Config *cfg);
+    ~MountSystem();
 
     void SetPosition_HA_Dec(double ha, double dec);
     void SetPosition_RA_Dec(double ra, double dec);
     void SetPosition_Az_Alt(double az, double alt);
 
+    // Mount is centered on the given object, add it to pointing model
+    bool AddSyncPoint_HA_Dec(double ha, double dec);
+    bool AddSyncPoint_RA_Dec(double ra, double dec);
+    // geometric Az/Alt, refraction is added as for RA/Dec
+    bool AddSyncPoint_Az_Alt(double az, double alt);
+    void ClearPointingModel();
+
     void GotoPosition_HA_Dec(double ha, double dec);
     void GotoPosition_RA_Dec(double ra, double dec);
     void GotoPosition_Az_Alt(double az, double alt);
+    // Follows satellite from its elements, false for deep space or broken ones
+    bool GotoSatellite(const TwoLineElements &tle);
+    // Sun, Moon or planet, ephemeris is shared and must outlive tracking
+    bool GotoBody(const Ephemeris *ephemeris, int body);
 
     void Move_HA_Dec(double dha, double ddec, double time);
     //bool AddGotoMovement_HA_Dec(double ha, double dec, double time);
@@ -49,11 +104,21 @@ public:
     std::tuple<double, double> CurrentPosition_RA_Dec();
     std::tuple<double, double> CurrentPosition_Az_Alt();
 
+    // Holds RA/Dec the mount points at now, moving at tracking rate
     void StartTracking_RA_Dec();
     void StopTracking();
+    // Custom rate is RA drift in seconds per hour and Dec drift in
+    // arcseconds per hour, e.g. of a comet, other rates ignore them
+    void SetTrackingRate(TrackingRate rate, double dra = 0, double ddec = 0);
+    TrackingRate CurrentTrackingRate();
     void TrackingPeriodic(double dt);
+    // Rate the control loop should run at, Hz, 0 keeps its own
+    double ControlRate();
+    // Runs lookahead generator when it has no thread of its own
+    void ProcessLookahead();
 
     bool ReadPosition();
+    void UpdatePosition(int x, int y, qint64 time);
     bool DecAxisDirection();
     void DisableSteppers();
     void NormalizeCoordinates();
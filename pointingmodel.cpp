@@ -0,0 +1,232 @@
+#include <QtMath>
+#include <QSettings>
+#include "pointingmodel.h"
+
+// a priori term sigma, arcsec, against ~30 arcsec of sync error
+static const double measure_sigma = 30;
+static const double prior_sigma[PointingTermCount] = {
+    36000, 36000, 3600, 3600, 7200, 7200, 1800
+};
+
+static const char *term_names[PointingTermCount] = {
+    "IH", "ID", "CH", "NP", "MA", "ME", "TF"
+};
+
+// sec(dec) close to the pole
+static const double min_cos_dec = 1e-3;
+
+PointingModel::PointingModel(double latitude, const QString &mount)
+{
+    group = mount.isEmpty() ? QString("pointing") : "pointing/" + mount;
+    sin_lat = sin(latitude * M_PI / 180);
+    cos_lat = cos(latitude * M_PI / 180);
+    generation = 0;
+    Reset();
+}
+
+void PointingModel::Reset()
+{
+    for (int i = 0; i < PointingTermCount; i++)
+    {
+        for (int j = 0; j < PointingTermCount; j++)
+            r[i][j] = 0;
+        r[i][i] = measure_sigma / prior_sigma[i];
+        rhs[i] = 0;
+        terms[i] = 0;
+    }
+    rss = 0;
+    points = 0;
+    generation++;
+}
+
+/*
+ * dH * cos(dec) = IH cos(dec) + CH + NP sin(dec) - MA cos(ha) sin(dec)
+ *                 + ME sin(ha) sin(dec) + TF cos(lat) sin(ha)
+ * dD            = ID + MA sin(ha) + ME cos(ha)
+ *                 + TF (cos(lat) cos(ha) sin(dec) - sin(lat) cos(dec))
+ */
+void PointingModel::Rows(double ha, double dec, double *h, double *d) const
+{
+    double sh = sin(ha * M_PI / 12), ch = cos(ha * M_PI / 12);
+    double sd = sin(dec * M_PI / 180), cd = cos(dec * M_PI / 180);
+
+    h[PointingIH] = cd;
+    h[PointingID] = 0;
+    h[PointingCH] = 1;
+    h[PointingNP] = sd;
+    h[PointingMA] = -ch * sd;
+    h[PointingME] = sh * sd;
+    h[PointingTF] = cos_lat * sh;
+
+    d[PointingIH] = 0;
+    d[PointingID] = 1;
+    d[PointingCH] = 0;
+    d[PointingNP] = 0;
+    d[PointingMA] = sh;
+    d[PointingME] = ch;
+    d[PointingTF] = cos_lat * ch * sd - sin_lat * cd;
+}
+
+void PointingModel::AddRow(double *a, double y)
+{
+    for (int i = 0; i < PointingTermCount; i++)
+    {
+        if (a[i] == 0)
+            continue;
+        double h = hypot(r[i][i], a[i]);
+        double c = r[i][i] / h;
+        double s = a[i] / h;
+        for (int j = i; j < PointingTermCount; j++)
+        {
+            double rij = r[i][j];
+            r[i][j] = c * rij + s * a[j];
+            a[j] = c * a[j] - s * rij;
+        }
+        double b = rhs[i];
+        rhs[i] = c * b + s * y;
+        y = c * y - s * b;
+    }
+    // what is left can't be explained by the terms
+    rss += y * y;
+}
+
+void PointingModel::Solve()
+{
+    for (int i = PointingTermCount - 1; i >= 0; i--)
+    {
+        double s = rhs[i];
+        for (int j = i + 1; j < PointingTermCount; j++)
+            s -= r[i][j] * terms[j];
+        terms[i] = s / r[i][i];
+    }
+}
+
+void PointingModel::AddPoint(double mount_ha, double mount_dec, double ha, double dec)
+{
+    double dha = mount_ha - ha;
+    if (dha > 12)
+        dha -= 24;
+    else if (dha < -12)
+        dha += 24;
+
+    double h[PointingTermCount], d[PointingTermCount];
+    Rows(mount_ha, mount_dec, h, d);
+    AddRow(h, dha * 15 * 3600 * cos(mount_dec * M_PI / 180));
+    AddRow(d, (mount_dec - dec) * 3600);
+    points++;
+    Solve();
+    generation++;
+}
+
+int PointingModel::Points() const
+{
+    return points;
+}
+
+int PointingModel::Generation() const
+{
+    return generation;
+}
+
+double PointingModel::Term(int term) const
+{
+    return terms[term];
+}
+
+const char *PointingModel::TermName(int term)
+{
+    return term_names[term];
+}
+
+double PointingModel::RMS() const
+{
+    if (points == 0)
+        return 0;
+    return sqrt(rss / (2 * points));
+}
+
+// dH in hours and dD in degrees
+std::tuple<double, double> PointingModel::Offset(double ha, double dec) const
+{
+    double h[PointingTermCount], d[PointingTermCount];
+    Rows(ha, dec, h, d);
+    double dh = 0, dd = 0;
+    for (int i = 0; i < PointingTermCount; i++)
+    {
+        dh += h[i] * terms[i];
+        dd += d[i] * terms[i];
+    }
+    double cd = cos(dec * M_PI / 180);
+    if (fabs(cd) < min_cos_dec)
+        cd = cd < 0 ? -min_cos_dec : min_cos_dec;
+    return std::make_tuple(dh / cd / (15 * 3600), dd / 3600);
+}
+
+std::tuple<double, double> PointingModel::ToMount(double ha, double dec) const
+{
+    if (points == 0)
+        return std::make_tuple(ha, dec);
+    auto o = Offset(ha, dec);
+    return std::make_tuple(ha + std::get<0>(o), dec + std::get<1>(o));
+}
+
+std::tuple<double, double> PointingModel::FromMount(double ha, double dec) const
+{
+    if (points == 0)
+        return std::make_tuple(ha, dec);
+    // terms are small, offset at the sky position converges in a few steps
+    double h = ha, d = dec;
+    for (int i = 0; i < 3; i++)
+    {
+        auto o = Offset(h, d);
+        h = ha - std::get<0>(o);
+        d = dec - std::get<1>(o);
+    }
+    return std::make_tuple(h, d);
+}
+
+void PointingModel::Save() const
+{
+    QSettings settings("gotocontrol", "gotocontrol");
+    settings.beginGroup(group);
+    settings.setValue("points", points);
+    settings.setValue("rss", rss);
+    for (int i = 0; i < PointingTermCount; i++)
+    {
+        QString term = term_names[i];
+        settings.setValue(term, terms[i]);
+        settings.setValue(term + "_rhs", rhs[i]);
+        QVariantList row;
+        for (int j = i; j < PointingTermCount; j++)
+            row.append(r[i][j]);
+        settings.setValue(term + "_r", row);
+    }
+    settings.endGroup();
+}
+
+bool PointingModel::Load()
+{
+    QSettings settings("gotocontrol", "gotocontrol");
+    settings.beginGroup(group);
+    if (!settings.contains("points"))
+        return false;
+
+    for (int i = 0; i < PointingTermCount; i++)
+    {
+        QVariantList row = settings.value(QString(term_names[i]) + "_r").toList();
+        if (row.size() != PointingTermCount - i)
+        {
+            Reset();
+            return false;
+        }
+        for (int j = i; j < PointingTermCount; j++)
+            r[i][j] = row[j - i].toDouble();
+        rhs[i] = settings.value(QString(term_names[i]) + "_rhs").toDouble();
+        terms[i] = settings.value(term_names[i]).toDouble();
+    }
+    points = settings.value("points").toInt();
+    rss = settings.value("rss").toDouble();
+    settings.endGroup();
+    generation++;
+    return true;
+}
@@ -0,0 +1,74 @@
+#ifndef POINTINGMODEL_H
+#define POINTINGMODEL_H
+
+#include <tuple>
+#include <QString>
+
+enum PointingTerm
+{
+    PointingIH = 0,     // hour angle index
+    PointingID,         // declination index
+    PointingCH,         // collimation (cone)
+    PointingNP,         // axes non-perpendicularity
+    PointingMA,         // polar axis azimuth
+    PointingME,         // polar axis elevation
+    PointingTF,         // tube flexure
+    PointingTermCount,
+};
+
+/*
+ * Pointing model of equatorial mount, TPOINT terms in arcsec.
+ *
+ * Works in mechanical coordinates, i.e. HA/Dec of the axes with
+ * dec beyond +-90 on the other side of the pier, so CH and NP change
+ * sign by themselves after meridian flip.
+ *
+ * Every sync point adds two rows (HA scaled by cos dec, and Dec) to the
+ * triangular factor by Givens rotations, terms are solved by back
+ * substitution, both O(terms^2). Factor starts as a ridge prior, so any
+ * number of points gives a solution and unobservable terms stay near 0.
+ */
+class PointingModel
+{
+private:
+    double sin_lat;
+    double cos_lat;
+    double r[PointingTermCount][PointingTermCount];
+    double rhs[PointingTermCount];
+    double rss;
+    int points;
+    double terms[PointingTermCount];
+    int generation;
+    // settings group the model is kept in
+    QString group;
+private:
+    void Rows(double ha, double dec, double *h, double *d) const;
+    void AddRow(double *a, double y);
+    void Solve();
+    std::tuple<double, double> Offset(double ha, double dec) const;
+public:
+    // every mount keeps its own model, empty name is the single mount one
+    PointingModel(double latitude, const QString &mount = QString());
+
+    void Reset();
+    // Axes position read from the mount and where it really points,
+    // both mechanical HA (hours) and Dec (degrees)
+    void AddPoint(double mount_ha, double mount_dec, double ha, double dec);
+
+    int Points() const;
+    // changes every time terms do
+    int Generation() const;
+    double Term(int term) const;
+    static const char *TermName(int term);
+    // residual per point on sky, arcsec
+    double RMS() const;
+
+    // Sky to axes position and back, mechanical coordinates
+    std::tuple<double, double> ToMount(double ha, double dec) const;
+    std::tuple<double, double> FromMount(double ha, double dec) const;
+
+    void Save() const;
+    bool Load();
+};
+
+#endif // POINTINGMODEL_H
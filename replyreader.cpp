@@ -0,0 +1,118 @@
+#include "replyreader.h"
+#include <cstring>
+
+ReplyReader::ReplyReader()
+{
+    head = 0;
+    tail = 0;
+}
+
+char *ReplyReader::WriteSpace(int *len)
+{
+    unsigned used = tail - head;
+    unsigned pos = tail % capacity;
+    unsigned free = capacity - used;
+    unsigned contiguous = capacity - pos;
+    *len = free < contiguous ? free : contiguous;
+    return ring + pos;
+}
+
+void ReplyReader::Commit(int len)
+{
+    tail += len;
+}
+
+int ReplyReader::Available() const
+{
+    return tail - head;
+}
+
+void ReplyReader::Clear()
+{
+    head = tail;
+}
+
+const char *ReplyReader::Span(unsigned offset, unsigned len)
+{
+    unsigned pos = (head + offset) % capacity;
+    if (pos + len <= capacity)
+        return ring + pos;
+    unsigned first = capacity - pos;
+    memcpy(scratch, ring + pos, first);
+    memcpy(scratch + first, ring, len - first);
+    return scratch;
+}
+
+bool ReplyReader::NextLine(const char **line, int *len)
+{
+    while (true)
+    {
+        unsigned available = tail - head;
+        unsigned end = 0;
+        while (end < available)
+        {
+            char c = ring[(head + end) % capacity];
+            if (c == '\r' || c == '\n')
+                break;
+            end++;
+        }
+        if (end == available)
+        {
+            // ring is full without a line end, nothing useful in it
+            if (available == capacity)
+                Clear();
+            return false;
+        }
+
+        const char *span = Span(0, end);
+        head += end + 1;
+        if (end == 0 || span[0] == ':')
+            continue;
+        *line = span;
+        *len = end;
+        return true;
+    }
+}
+
+const char *ReplyReader::Peek(int *len)
+{
+    unsigned available = tail - head;
+    if ((unsigned)*len > available)
+        *len = available;
+    return Span(0, *len);
+}
+
+void ReplyReader::Consume(int len)
+{
+    head += len;
+}
+
+int ParseOctalFields(const char *s, int len, int *fields, int count)
+{
+    int parsed = 0;
+    int i = 0;
+    while (parsed < count)
+    {
+        while (i < len && s[i] == ' ')
+            i++;
+        if (i >= len)
+            break;
+
+        bool negative = false;
+        if (s[i] == '-')
+        {
+            negative = true;
+            i++;
+        }
+        if (i >= len || s[i] < '0' || s[i] > '7')
+            break;
+        unsigned value = 0;
+        while (i < len && s[i] >= '0' && s[i] <= '7')
+        {
+            value = value * 8 + (s[i] - '0');
+            i++;
+        }
+        fields[parsed++] = negative ? -(int)value : (int)value;
+    }
+    return parsed;
+}
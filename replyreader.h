@@ -0,0 +1,44 @@
+#ifndef REPLYREADER_H
+#define REPLYREADER_H
+
+/*
+ * Receive buffer of the mount link.
+ *
+ * Fixed ring, bytes are read from the port straight into it and lines
+ * are found in place, nothing is allocated on the hot path. Only a line
+ * or frame crossing the end of the ring is copied to a scratch buffer.
+ * Returned pointers are valid until the next write to the ring.
+ */
+class ReplyReader
+{
+private:
+    static const unsigned capacity = 1024;
+    char ring[capacity];
+    char scratch[capacity];
+    // read and write positions, run freely and wrap around
+    unsigned head;
+    unsigned tail;
+private:
+    const char *Span(unsigned offset, unsigned len);
+public:
+    ReplyReader();
+
+    // Free contiguous space for the next read from the port
+    char *WriteSpace(int *len);
+    void Commit(int len);
+
+    int Available() const;
+    void Clear();
+
+    // Next reply line without CR/LF. Empty and ':' echo lines are skipped
+    bool NextLine(const char **line, int *len);
+
+    // First len bytes as contiguous memory, len is clamped to available data
+    const char *Peek(int *len);
+    void Consume(int len);
+};
+
+// Parses space separated octal integers, returns number of parsed fields
+int ParseOctalFields(const char *s, int len, int *fields, int count);
+
+#endif // REPLYREADER_H
@@ -0,0 +1,214 @@
+#include <QtMath>
+#include "segmentgenerator.h"
+#include "chebyshev.h"
+#include "timebase.h"
+
+SegmentGenerator::SegmentGenerator(MountDevice *ctl, double max_speed_x, double max_speed_y)
+{
+    this->ctl = ctl;
+    this->max_speed_x = max_speed_x / 1e6;
+    this->max_speed_y = max_speed_y / 1e6;
+    tick = 100;
+    timer = nullptr;
+    wakeup_pending = false;
+    has_path = false;
+    path_pending = false;
+    resets = 0;
+    horizon = 0;
+    segment_time = 0;
+    ahead_x = ahead_y = 0;
+    ahead_time = 0;
+    sent_valid = false;
+    sent_x = sent_y = 0;
+    sent_time = 0;
+}
+
+void SegmentGenerator::Start()
+{
+    timer = new QTimer(this);
+    connect(timer, SIGNAL(timeout()), this, SLOT(Process()));
+    timer->start(tick);
+}
+
+void SegmentGenerator::Stop()
+{
+    if (timer)
+    {
+        timer->stop();
+        delete timer;
+        timer = nullptr;
+    }
+}
+
+void SegmentGenerator::Post(const SegmentPath &path)
+{
+    {
+        QMutexLocker locker(&mutex);
+        bool restart = path_pending && pending.restart;
+        pending = path;
+        pending.restart = path.restart || restart;
+        path_pending = true;
+    }
+    if (!wakeup_pending.exchange(true))
+        QMetaObject::invokeMethod(this, "Process", Qt::QueuedConnection);
+}
+
+std::tuple<bool, double, double, qint64> SegmentGenerator::End()
+{
+    QMutexLocker locker(&mutex);
+    return std::make_tuple(sent_valid, sent_x, sent_y, sent_time);
+}
+
+void SegmentGenerator::Reset()
+{
+    QMutexLocker locker(&mutex);
+    path_pending = false;
+    sent_valid = false;
+    resets++;
+}
+
+bool SegmentGenerator::Restart(int taken)
+{
+    auto p = ctl->ReadPositionTimed();
+    QMutexLocker locker(&mutex);
+    // reset while reading, position and path are from before D or S
+    if (resets != taken)
+        return false;
+    sent_valid = std::get<0>(p);
+    sent_x = std::get<1>(p);
+    sent_y = std::get<2>(p);
+    sent_time = Timebase::Now();
+    return true;
+}
+
+bool SegmentGenerator::TakePath()
+{
+    bool valid;
+    int taken;
+    {
+        QMutexLocker locker(&mutex);
+        if (!path_pending)
+            return false;
+        path = pending;
+        path_pending = false;
+        valid = sent_valid;
+        taken = resets;
+    }
+    ahead.clear();
+    if ((path.restart || !valid) && !Restart(taken))
+    {
+        has_path = false;
+        return true;
+    }
+    has_path = path.valid;
+    ahead_x = sent_x;
+    ahead_y = sent_y;
+    qint64 now = Timebase::Now();
+    ahead_time = qMax(sent_time, now);
+    if (!has_path)
+        return true;
+
+    // short segments need feeding more often
+    horizon = path.horizon;
+    segment_time = path.segment_time;
+    if (timer)
+        timer->setInterval(qBound(10, segment_time / 2000, tick));
+
+    for (const MountSegment &s : path.slew)
+    {
+        ahead.enqueue(s);
+        ahead_x += s.dx;
+        ahead_y += s.dy;
+        ahead_time += s.time * 1000LL;
+    }
+    return true;
+}
+
+void SegmentGenerator::Fill()
+{
+    qint64 limit = qMin(Timebase::Now() + horizon, path.end);
+    qint64 step = segment_time * 1000LL;
+    double span = path.end - path.start;
+    while (ahead_time + step <= limit)
+    {
+        qint64 t = ahead_time + step;
+        double u = 2 * (t - path.start) / span - 1;
+        double dx = ChebyshevEval(path.x, SegmentPath::order, u) - ahead_x;
+        double dy = ChebyshevEval(path.y, SegmentPath::order, u) - ahead_y;
+
+        // target path is smooth, but keep within axis speed anyway
+        double k = 1;
+        if (fabs(dx) > max_speed_x * segment_time)
+            k = max_speed_x * segment_time / fabs(dx);
+        if (fabs(dy) * k > max_speed_y * segment_time)
+            k = max_speed_y * segment_time / fabs(dy);
+        MountSegment s;
+        s.dx = qRound(dx * k);
+        s.dy = qRound(dy * k);
+        s.time = segment_time;
+        // holding still, try again later from the current time
+        if (s.dx == 0 && s.dy == 0)
+            break;
+        ahead.enqueue(s);
+        ahead_x += s.dx;
+        ahead_y += s.dy;
+        ahead_time = t;
+    }
+}
+
+void SegmentGenerator::Feed()
+{
+    if (ahead.isEmpty())
+        return;
+    int free = ctl->FreeQueueLines();
+
+    // held while sending, segments never go out after Reset()
+    QMutexLocker locker(&mutex);
+    if (!sent_valid)
+    {
+        ahead.clear();
+        return;
+    }
+    QVector<MountSegment> batch;
+    double x = sent_x, y = sent_y;
+    qint64 now = Timebase::Now();
+    qint64 time = qMax(sent_time, now);
+    while (free-- > 0 && !ahead.isEmpty())
+    {
+        MountSegment s = ahead.dequeue();
+        batch.append(s);
+        x += s.dx;
+        y += s.dy;
+        time += s.time * 1000LL;
+    }
+    if (batch.isEmpty())
+        return;
+    ctl->RequestGotoBatch(batch);
+    sent_x = x;
+    sent_y = y;
+    sent_time = time;
+}
+
+void SegmentGenerator::Process()
+{
+    wakeup_pending = false;
+    TakePath();
+
+    bool valid;
+    {
+        QMutexLocker locker(&mutex);
+        valid = sent_valid;
+    }
+    qint64 now = Timebase::Now();
+    if (has_path && valid && sent_time + 2 * tick * 1000000LL < now)
+    {
+        // mount ran out of segments, precomputed ones are late now
+        ahead.clear();
+        ahead_x = sent_x;
+        ahead_y = sent_y;
+        ahead_time = now;
+    }
+    if (has_path)
+        Fill();
+    Feed();
+}
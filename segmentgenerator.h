@@ -0,0 +1,93 @@
+#ifndef SEGMENTGENERATOR_H
+#define SEGMENTGENERATOR_H
+
+#include <QObject>
+#include <QQueue>
+#include <QMutex>
+#include <QTimer>
+#include <atomic>
+#include "mountdevice.h"
+
+// Target position in motor steps, valid over [start, end]
+struct SegmentPath
+{
+    static const int order = 9;
+
+    bool valid;         // false stops motion generation
+    bool restart;       // mount position was changed, start from read one
+    // leading segments, e.g. planned slew
+    QVector<MountSegment> slew;
+    // Timebase nsec, start is where slew ends
+    qint64 start;
+    qint64 end;
+    // how far ahead segments are kept, nsec, and their length, usec
+    qint64 horizon;
+    int segment_time;
+    // Chebyshev series over [start, end]
+    double x[order];
+    double y[order];
+};
+
+/*
+ * Lookahead generator of controller segments.
+ *
+ * Runs in its own thread. Keeps segments precomputed for the horizon
+ * from the path posted by MountSystem and feeds them to the controller
+ * whenever its queue has space, so tracking does not depend on GUI timer.
+ * New path replaces precomputed segments, already sent ones are kept and
+ * the new ones continue from their end. Paths not taken yet are replaced
+ * by newer ones, restart request of a replaced path is kept.
+ */
+class SegmentGenerator : public QObject
+{
+    Q_OBJECT
+private:
+    MountDevice *ctl;
+    double max_speed_x;     // steps per usec
+    double max_speed_y;
+    int tick;               // msec
+
+    std::atomic<bool> wakeup_pending;
+
+    // owned by generator thread
+    QTimer *timer;
+    bool has_path;
+    SegmentPath path;
+    qint64 horizon;         // nsec
+    int segment_time;       // usec
+    QQueue<MountSegment> ahead;
+    double ahead_x, ahead_y;
+    qint64 ahead_time;
+
+    QMutex mutex;
+    // posted path, newest one wins
+    bool path_pending;
+    SegmentPath pending;
+    // counts Reset() calls, path taken before one is dropped
+    int resets;
+    // end of segments sent to the controller, read by MountSystem
+    bool sent_valid;
+    double sent_x, sent_y;
+    qint64 sent_time;
+private:
+    bool TakePath();
+    bool Restart(int taken);
+    void Fill();
+    void Feed();
+public:
+    SegmentGenerator(MountDevice *ctl, double max_speed_x, double max_speed_y);
+
+    // Called from MountSystem thread
+    void Post(const SegmentPath &path);
+    // Before D or S: drops precomputed segments and the posted path,
+    // nothing is sent until a path posted after it
+    void Reset();
+    // End of sent segments in steps and its Timebase time
+    std::tuple<bool, double, double, qint64> End();
+public slots:
+    void Start();
+    void Stop();
+    void Process();
+};
+
+#endif // SEGMENTGENERATOR_H
@@ -0,0 +1,368 @@
+#include <QFile>
+#include <QTextStream>
+#include <QtMath>
+#include "sgp4.h"
+#include "timebase.h"
+
+// WGS72
+static const double radiusearthkm = 6378.135;
+static const double xke = 0.0743669161331734132;    // sqrt(mu / re^3), 1 / min
+static const double j2 = 0.001082616;
+static const double j3 = -0.00000253881;
+static const double j4 = -0.00000165597;
+static const double j3oj2 = j3 / j2;
+static const double x2o3 = 2.0 / 3.0;
+static const double twopi = 2 * M_PI;
+static const double deg = M_PI / 180;
+
+static const int64_t nsec_per_day = 86400LL * 1000000000LL;
+
+// days from 1970-01-01 to given date, proleptic Gregorian
+static int64_t days_from_civil(int y, int m, int d)
+{
+    y -= m <= 2;
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    int64_t yoe = y - era * 400;
+    int64_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+static bool checksum(const QString &line)
+{
+    int sum = 0;
+    for (int i = 0; i < 68; i++)
+    {
+        QChar c = line[i];
+        if (c.isDigit())
+            sum += c.digitValue();
+        else if (c == '-')
+            sum += 1;
+    }
+    return line[68].digitValue() == sum % 10;
+}
+
+// " 12345-4" is 0.12345e-4, decimal point is implied
+static double implied(const QString &field)
+{
+    QString s = field.trimmed();
+    if (s.isEmpty())
+        return 0;
+    double sign = 1;
+    if (s[0] == '-' || s[0] == '+')
+    {
+        sign = s[0] == '-' ? -1 : 1;
+        s = s.mid(1);
+    }
+    int e = qMax(s.lastIndexOf('-'), s.lastIndexOf('+'));
+    if (e <= 0)
+        return sign * ("0." + s).toDouble();
+    return sign * ("0." + s.left(e)).toDouble() * pow(10, s.mid(e).toInt());
+}
+
+bool ParseTLE(const QString &line1, const QString &line2, TwoLineElements *tle)
+{
+    if (line1.length() < 69 || line2.length() < 69 || line1[0] != '1' || line2[0] != '2')
+        return false;
+    if (!checksum(line1) || !checksum(line2))
+        return false;
+
+    tle->catalog = line1.mid(2, 5).trimmed().toInt();
+    int year = line1.mid(18, 2).toInt();
+    year += year < 57 ? 2000 : 1900;
+    double day = line1.mid(20, 12).toDouble();
+    tle->epoch = days_from_civil(year, 1, 1) * nsec_per_day + qRound64((day - 1) * nsec_per_day);
+    tle->bstar = implied(line1.mid(53, 8));
+
+    tle->inclination = line2.mid(8, 8).toDouble();
+    tle->raan = line2.mid(17, 8).toDouble();
+    tle->eccentricity = ("0." + line2.mid(26, 7).trimmed()).toDouble();
+    tle->argument_of_perigee = line2.mid(34, 8).toDouble();
+    tle->mean_anomaly = line2.mid(43, 8).toDouble();
+    tle->mean_motion = line2.mid(52, 11).toDouble();
+    return true;
+}
+
+QVector<TwoLineElements> LoadTLE(const QString &filename)
+{
+    QVector<TwoLineElements> result;
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly))
+        return result;
+    QTextStream in(&file);
+    QString name;
+    QString line1;
+    while (!in.atEnd())
+    {
+        QString line = in.readLine();
+        while (line.endsWith('\r'))
+            line.chop(1);
+        if (line.startsWith("1 ") && line.length() >= 69)
+        {
+            line1 = line;
+        }
+        else if (line.startsWith("2 ") && !line1.isEmpty())
+        {
+            TwoLineElements tle;
+            if (ParseTLE(line1, line, &tle))
+            {
+                tle.name = name.isEmpty() ? QString::number(tle.catalog) : name;
+                result.append(tle);
+            }
+            line1.clear();
+            name.clear();
+        }
+        else if (!line.trimmed().isEmpty())
+        {
+            // name line of 3 line format, "0 " prefix is optional
+            name = line.startsWith("0 ") ? line.mid(2).trimmed() : line.trimmed();
+            line1.clear();
+        }
+    }
+    return result;
+}
+
+SGP4::SGP4()
+{
+    valid = false;
+}
+
+SGP4::SGP4(const TwoLineElements &tle)
+{
+    epoch = tle.epoch;
+    bstar = tle.bstar;
+    inclo = tle.inclination * deg;
+    nodeo = tle.raan * deg;
+    ecco = tle.eccentricity;
+    argpo = tle.argument_of_perigee * deg;
+    mo = tle.mean_anomaly * deg;
+    double no_kozai = tle.mean_motion * twopi / 1440;
+
+    // recover original mean motion and semimajor axis from Kozai mean motion
+    double eccsq = ecco * ecco;
+    double omeosq = 1 - eccsq;
+    double rteosq = sqrt(omeosq);
+    double cosio = cos(inclo);
+    double cosio2 = cosio * cosio;
+    double ak = pow(xke / no_kozai, x2o3);
+    double d1 = 0.75 * j2 * (3 * cosio2 - 1) / (rteosq * omeosq);
+    double del = d1 / (ak * ak);
+    double adel = ak * (1 - del * del - del * (1.0 / 3.0 + 134 * del * del / 81));
+    del = d1 / (adel * adel);
+    no_unkozai = no_kozai / (1 + del);
+
+    double ao = pow(xke / no_unkozai, x2o3);
+    double sinio = sin(inclo);
+    double po = ao * omeosq;
+    double con42 = 1 - 5 * cosio2;
+    con41 = -con42 - cosio2 - cosio2;
+    double posq = po * po;
+    double rp = ao * (1 - ecco);
+
+    valid = omeosq > 0 && no_unkozai > 0 && twopi / no_unkozai < 225;
+    if (!valid)
+        return;
+
+    // perigee below 220 km gets truncated drag terms
+    isimp = rp < 220 / radiusearthkm + 1;
+    double sfour = 78 / radiusearthkm + 1;
+    double qzms24 = pow((120 - 78) / radiusearthkm, 4);
+    double perige = (rp - 1) * radiusearthkm;
+    if (perige < 156)
+    {
+        sfour = perige < 98 ? 20 : perige - 78;
+        qzms24 = pow((120 - sfour) / radiusearthkm, 4);
+        sfour = sfour / radiusearthkm + 1;
+    }
+    double pinvsq = 1 / posq;
+
+    double tsi = 1 / (ao - sfour);
+    eta = ao * ecco * tsi;
+    double etasq = eta * eta;
+    double eeta = ecco * eta;
+    double psisq = fabs(1 - etasq);
+    double coef = qzms24 * pow(tsi, 4);
+    double coef1 = coef / pow(psisq, 3.5);
+    double cc2 = coef1 * no_unkozai * (ao * (1 + 1.5 * etasq + eeta * (4 + etasq)) +
+                 0.375 * j2 * tsi / psisq * con41 * (8 + 3 * etasq * (8 + etasq)));
+    cc1 = bstar * cc2;
+    double cc3 = 0;
+    if (ecco > 1e-4)
+        cc3 = -2 * coef * tsi * j3oj2 * no_unkozai * sinio / ecco;
+    x1mth2 = 1 - cosio2;
+    cc4 = 2 * no_unkozai * coef1 * ao * omeosq *
+          (eta * (2 + 0.5 * etasq) + ecco * (0.5 + 2 * etasq) -
+           j2 * tsi / (ao * psisq) *
+           (-3 * con41 * (1 - 2 * eeta + etasq * (1.5 - 0.5 * eeta)) +
+            0.75 * x1mth2 * (2 * etasq - eeta * (1 + etasq)) * cos(2 * argpo)));
+    cc5 = 2 * coef1 * ao * omeosq * (1 + 2.75 * (etasq + eeta) + eeta * etasq);
+
+    double cosio4 = cosio2 * cosio2;
+    double temp1 = 1.5 * j2 * pinvsq * no_unkozai;
+    double temp2 = 0.5 * temp1 * j2 * pinvsq;
+    double temp3 = -0.46875 * j4 * pinvsq * pinvsq * no_unkozai;
+    mdot = no_unkozai + 0.5 * temp1 * rteosq * con41 +
+           0.0625 * temp2 * rteosq * (13 - 78 * cosio2 + 137 * cosio4);
+    argpdot = -0.5 * temp1 * con42 + 0.0625 * temp2 * (7 - 114 * cosio2 + 395 * cosio4) +
+              temp3 * (3 - 36 * cosio2 + 49 * cosio4);
+    double xhdot1 = -temp1 * cosio;
+    nodedot = xhdot1 + (0.5 * temp2 * (4 - 19 * cosio2) + 2 * temp3 * (3 - 7 * cosio2)) * cosio;
+    omgcof = bstar * cc3 * cos(argpo);
+    xmcof = 0;
+    if (ecco > 1e-4)
+        xmcof = -x2o3 * coef * bstar / eeta;
+    nodecf = 3.5 * omeosq * xhdot1 * cc1;
+    t2cof = 1.5 * cc1;
+    if (fabs(cosio + 1) > 1.5e-12)
+        xlcof = -0.25 * j3oj2 * sinio * (3 + 5 * cosio) / (1 + cosio);
+    else
+        xlcof = -0.25 * j3oj2 * sinio * (3 + 5 * cosio) / 1.5e-12;
+    aycof = -0.5 * j3oj2 * sinio;
+    delmo = pow(1 + eta * cos(mo), 3);
+    sinmao = sin(mo);
+    x7thm1 = 7 * cosio2 - 1;
+
+    d2 = d3 = d4 = t3cof = t4cof = t5cof = 0;
+    if (!isimp)
+    {
+        double cc1sq = cc1 * cc1;
+        d2 = 4 * ao * tsi * cc1sq;
+        double temp = d2 * tsi * cc1 / 3;
+        d3 = (17 * ao + sfour) * temp;
+        d4 = 0.5 * temp * ao * tsi * (221 * ao + 31 * sfour) * cc1;
+        t3cof = d2 + 2 * cc1sq;
+        t4cof = 0.25 * (3 * d3 + cc1 * (12 * d2 + 10 * cc1sq));
+        t5cof = 0.2 * (3 * d4 + 12 * cc1 * d3 + 6 * d2 * d2 + 15 * cc1sq * (2 * d2 + cc1sq));
+    }
+}
+
+bool SGP4::Valid() const
+{
+    return valid;
+}
+
+bool SGP4::Propagate(double t, double r[3], double v[3]) const
+{
+    if (!valid)
+        return false;
+
+    // secular gravity and atmospheric drag
+    double xmdf = mo + mdot * t;
+    double argpdf = argpo + argpdot * t;
+    double nodedf = nodeo + nodedot * t;
+    double argpm = argpdf;
+    double mm = xmdf;
+    double t2 = t * t;
+    double nodem = nodedf + nodecf * t2;
+    double tempa = 1 - cc1 * t;
+    double tempe = bstar * cc4 * t;
+    double templ = t2cof * t2;
+    if (!isimp)
+    {
+        double delomg = omgcof * t;
+        double delm = xmcof * (pow(1 + eta * cos(xmdf), 3) - delmo);
+        double temp = delomg + delm;
+        mm = xmdf + temp;
+        argpm = argpdf - temp;
+        double t3 = t2 * t;
+        double t4 = t3 * t;
+        tempa = tempa - d2 * t2 - d3 * t3 - d4 * t4;
+        tempe = tempe + bstar * cc5 * (sin(mm) - sinmao);
+        templ = templ + t3cof * t3 + t4 * (t4cof + t * t5cof);
+    }
+
+    double am = pow(xke / no_unkozai, x2o3) * tempa * tempa;
+    double nm = xke / pow(am, 1.5);
+    double em = ecco - tempe;
+    if (em >= 1 || em < -0.001 || am < 0.95)
+        return false;
+    if (em < 1e-6)
+        em = 1e-6;
+    mm = mm + no_unkozai * templ;
+    double xlm = mm + argpm + nodem;
+    nodem = fmod(nodem, twopi);
+    argpm = fmod(argpm, twopi);
+    xlm = fmod(xlm, twopi);
+    mm = fmod(xlm - argpm - nodem, twopi);
+
+    // long period periodics
+    double sinip = sin(inclo);
+    double cosip = cos(inclo);
+    double axnl = em * cos(argpm);
+    double temp = 1 / (am * (1 - em * em));
+    double aynl = em * sin(argpm) + temp * aycof;
+    double xl = mm + argpm + nodem + temp * xlcof * axnl;
+
+    // Kepler equation
+    double u = fmod(xl - nodem, twopi);
+    double eo1 = u;
+    double tem5 = 9999.9;
+    double sineo1 = 0, coseo1 = 0;
+    for (int ktr = 1; fabs(tem5) >= 1e-12 && ktr <= 10; ktr++)
+    {
+        sineo1 = sin(eo1);
+        coseo1 = cos(eo1);
+        tem5 = 1 - coseo1 * axnl - sineo1 * aynl;
+        tem5 = (u - aynl * coseo1 + axnl * sineo1 - eo1) / tem5;
+        if (fabs(tem5) >= 0.95)
+            tem5 = tem5 > 0 ? 0.95 : -0.95;
+        eo1 = eo1 + tem5;
+    }
+
+    // short period periodics
+    double ecose = axnl * coseo1 + aynl * sineo1;
+    double esine = axnl * sineo1 - aynl * coseo1;
+    double el2 = axnl * axnl + aynl * aynl;
+    double pl = am * (1 - el2);
+    if (pl < 0)
+        return false;
+    double rl = am * (1 - ecose);
+    double rdotl = sqrt(am) * esine / rl;
+    double rvdotl = sqrt(pl) / rl;
+    double betal = sqrt(1 - el2);
+    temp = esine / (1 + betal);
+    double sinu = am / rl * (sineo1 - aynl - axnl * temp);
+    double cosu = am / rl * (coseo1 - axnl + aynl * temp);
+    double su = atan2(sinu, cosu);
+    double sin2u = (cosu + cosu) * sinu;
+    double cos2u = 1 - 2 * sinu * sinu;
+    temp = 1 / pl;
+    double temp1 = 0.5 * j2 * temp;
+    double temp2 = temp1 * temp;
+
+    double mrt = rl * (1 - 1.5 * temp2 * betal * con41) + 0.5 * temp1 * x1mth2 * cos2u;
+    su = su - 0.25 * temp2 * x7thm1 * sin2u;
+    double xnode = nodem + 1.5 * temp2 * cosip * sin2u;
+    double xinc = inclo + 1.5 * temp2 * cosip * sinip * cos2u;
+    double mvt = rdotl - nm * temp1 * x1mth2 * sin2u / xke;
+    double rvdot = rvdotl + nm * temp1 * (x1mth2 * cos2u + 1.5 * con41) / xke;
+    if (mrt < 1)
+        return false;
+
+    double sinsu = sin(su), cossu = cos(su);
+    double snod = sin(xnode), cnod = cos(xnode);
+    double sini = sin(xinc), cosi = cos(xinc);
+    double xmx = -snod * cosi;
+    double xmy = cnod * cosi;
+    double ux = xmx * sinsu + cnod * cossu;
+    double uy = xmy * sinsu + snod * cossu;
+    double uz = sini * sinsu;
+    double vx = xmx * cossu - cnod * sinsu;
+    double vy = xmy * cossu - snod * sinsu;
+    double vz = sini * cossu;
+
+    const double vkmpersec = radiusearthkm * xke / 60;
+    r[0] = mrt * ux * radiusearthkm;
+    r[1] = mrt * uy * radiusearthkm;
+    r[2] = mrt * uz * radiusearthkm;
+    v[0] = (mvt * ux + rvdot * vx) * vkmpersec;
+    v[1] = (mvt * uy + rvdot * vy) * vkmpersec;
+    v[2] = (mvt * uz + rvdot * vz) * vkmpersec;
+    return true;
+}
+
+bool SGP4::At(int64_t time, double r[3], double v[3]) const
+{
+    double tsince = (Timebase::ToUTC(time) - epoch) / 60e9;
+    return Propagate(tsince, r, v);
+}
@@ -0,0 +1,58 @@
+#ifndef SGP4_H
+#define SGP4_H
+
+#include <QString>
+#include <QVector>
+#include <cstdint>
+
+// Mean elements of a NORAD two-line element set
+struct TwoLineElements
+{
+    QString name;
+    int catalog;
+    // UTC nanoseconds since Unix epoch
+    int64_t epoch;
+    double bstar;           // 1 / earth radii
+    double inclination;     // degrees
+    double raan;
+    double eccentricity;
+    double argument_of_perigee;
+    double mean_anomaly;
+    double mean_motion;     // revolutions per day
+};
+
+// Parses one element set, line checksums are verified
+bool ParseTLE(const QString &line1, const QString &line2, TwoLineElements *tle);
+// Element sets from a file in 2 or 3 line format, broken ones are skipped
+QVector<TwoLineElements> LoadTLE(const QString &filename);
+
+/*
+ * SGP4 propagator, near Earth orbits only (period under 225 min).
+ *
+ * Follows Vallado et al. "Revisiting Spacetrack Report #3" (2006) with
+ * WGS72 constants, as the element sets are fitted with them. Deep space
+ * (SDP4) terms are not implemented, such orbits are reported invalid.
+ * Position and velocity are in TEME frame, km and km/s.
+ */
+class SGP4
+{
+private:
+    bool valid;
+    int64_t epoch;
+    double bstar, inclo, nodeo, ecco, argpo, mo, no_unkozai;
+    bool isimp;
+    double aycof, con41, cc1, cc4, cc5, d2, d3, d4, delmo, eta, argpdot, omgcof;
+    double sinmao, t2cof, t3cof, t4cof, t5cof, x1mth2, x7thm1, mdot, nodedot;
+    double xlcof, xmcof, nodecf;
+public:
+    SGP4();
+    SGP4(const TwoLineElements &tle);
+
+    bool Valid() const;
+    // Minutes since element epoch, false when orbit has decayed
+    bool Propagate(double tsince, double r[3], double v[3]) const;
+    // Timebase nanoseconds
+    bool At(int64_t time, double r[3], double v[3]) const;
+};
+
+#endif // SGP4_H
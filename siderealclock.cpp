@@ -0,0 +1,54 @@
+#include "siderealclock.h"
+#include "timebase.h"
+#include <cmath>
+
+// 2000-01-01 00:00 UTC
+static const int64_t epoch2000 = 946684800LL * 1000000000LL;
+static const int64_t nsecs_per_day = 86400LL * 1000000000LL;
+
+// GMST at 0h UT 2000-01-01, degrees, and its polynomial in days
+static const double L0 = 99.967794687;
+static const double L1 = 360.98564736628603;
+static const double L2 = 2.907879e-13;
+static const double L3 = -5.302e-22;
+
+SiderealClock::SiderealClock(double longitude)
+{
+    this->longitude = longitude;
+    Anchor(Timebase::Now());
+}
+
+double SiderealClock::Reduce(double angle) const
+{
+    return angle - floor(angle / 360) * 360;
+}
+
+void SiderealClock::Anchor(int64_t time)
+{
+    anchor_time = time;
+
+    // whole turns per day are dropped before they eat the precision
+    int64_t nsecs = Timebase::ToUTC(time) - epoch2000;
+    double days = (double)nsecs / nsecs_per_day;
+    double day_fraction = (double)(nsecs % nsecs_per_day) / nsecs_per_day;
+    double angle = L0 + 360 * day_fraction + (L1 - 360) * days
+                 + L2 * days * days + L3 * days * days * days;
+    anchor_angle = Reduce(angle + longitude);
+    rate = (L1 + 2 * L2 * days + 3 * L3 * days * days) / nsecs_per_day;
+}
+
+double SiderealClock::LST(int64_t time) const
+{
+    return Reduce(anchor_angle + rate * (double)(time - anchor_time)) * 24 / 360;
+}
+
+double SiderealClock::Now() const
+{
+    return LST(Timebase::Now());
+}
+
+void SiderealClock::LST(const int64_t *time, double *lst, int n) const
+{
+    for (int i = 0; i < n; i++)
+        lst[i] = Reduce(anchor_angle + rate * (double)(time[i] - anchor_time)) * 24 / 360;
+}
@@ -0,0 +1,36 @@
+#ifndef SIDEREALCLOCK_H
+#define SIDEREALCLOCK_H
+
+#include <cstdint>
+
+/*
+ * Local sidereal time, anchored once and advanced linearly.
+ *
+ * GMST polynomial is evaluated at the anchor only, later times add
+ * rate * dt. Curvature of the polynomial gives 1e-12 deg error over
+ * a year from the anchor, so no re-anchoring is needed while running.
+ * Times are Timebase nanoseconds.
+ */
+class SiderealClock
+{
+private:
+    double longitude;
+    int64_t anchor_time;
+    // local sidereal angle at anchor, degrees in [0, 360)
+    double anchor_angle;
+    // degrees per nsec
+    double rate;
+private:
+    double Reduce(double angle) const;
+public:
+    SiderealClock(double longitude);
+
+    void Anchor(int64_t time);
+
+    // Local sidereal time, hours in [0, 24)
+    double LST(int64_t time) const;
+    double Now() const;
+    void LST(const int64_t *time, double *lst, int n) const;
+};
+
+#endif // SIDEREALCLOCK_H
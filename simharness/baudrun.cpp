@@ -0,0 +1,51 @@
+#include <QElapsedTimer>
+#include <QThread>
+#include "baudrun.h"
+#include "mountcontroller.h"
+#include "mountsimulator.h"
+#include "ptysimulator.h"
+
+const BaudScenario baud_scenarios[] = {
+    {"baud-switch",   115200, 0,      true},
+    {"baud-fallback", 115200, 115200, false},
+};
+
+const int baud_scenario_count = sizeof(baud_scenarios) / sizeof(baud_scenarios[0]);
+
+bool RunBaud(const BaudScenario &scenario, BaudResult *result, QString *error)
+{
+    // controller blocks while waiting for replies, terminal runs in its own thread
+    MountSimulator sim(2, true, scenario.rate);
+    QThread thread;
+    PtySimulator *pty = new PtySimulator(&sim, 0, 0);
+    pty->SetDeadBaudRate(scenario.dead_rate);
+    pty->moveToThread(&thread);
+    QObject::connect(&thread, &QThread::finished, pty, &QObject::deleteLater);
+    thread.start();
+
+    bool opened = false;
+    QMetaObject::invokeMethod(pty, "Open", Qt::BlockingQueuedConnection, Q_RETURN_ARG(bool, opened));
+    if (opened)
+    {
+        MountController ctl(pty->SlaveName(), 9600);
+        opened = ctl.Open();
+        if (opened)
+        {
+            QElapsedTimer timer;
+            timer.start();
+            result->negotiated = ctl.NegotiateBaudRate(scenario.rate);
+            result->seconds = timer.elapsed() / 1000.0;
+            result->link_rate = ctl.BaudRate();
+            result->position = std::get<0>(ctl.ReadPosition());
+        }
+    }
+    thread.quit();
+    thread.wait();
+    if (!opened)
+    {
+        *error = "Can not open pseudo-terminal";
+        return false;
+    }
+    result->firmware_rate = sim.BaudRate();
+    return true;
+}
@@ -0,0 +1,35 @@
+#ifndef BAUDRUN_H
+#define BAUDRUN_H
+
+#include <QString>
+
+/*
+ * Baud rate negotiation against simulated firmware on a pseudo-terminal,
+ * in real time: controller has to switch, or fall back when the line
+ * does not carry the new rate, and answer position requests after.
+ */
+
+struct BaudScenario
+{
+    const char *name;
+    int rate;
+    // line loses everything at this rate, 0 for none
+    int dead_rate;
+    bool switched;
+};
+
+extern const BaudScenario baud_scenarios[];
+extern const int baud_scenario_count;
+
+struct BaudResult
+{
+    bool negotiated;
+    double seconds;
+    int link_rate;
+    int firmware_rate;
+    bool position;
+};
+
+bool RunBaud(const BaudScenario &scenario, BaudResult *result, QString *error);
+
+#endif // BAUDRUN_H
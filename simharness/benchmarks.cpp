@@ -0,0 +1,199 @@
+#include <QByteArray>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QTimeZone>
+#include <QVector>
+#include <cmath>
+#include <cstring>
+#include "benchmarks.h"
+#include "replyreader.h"
+#include "siderealclock.h"
+#include "timebase.h"
+
+// serial reads deliver this much at a time
+static const int read_chunk = 64;
+
+static QByteArray ReplyStream(int replies)
+{
+    QByteArray stream;
+    for (int i = 0; i < replies; i++)
+    {
+        // echo of the command, then position with controller time
+        if (i % 4 == 0)
+            stream += ":P\r\n";
+        stream += QByteArray::number(i % 128, 8) + " " +
+                  QByteArray::number(3400517 + i, 8) + " " +
+                  QByteArray::number(3777220 - i, 8) + " " +
+                  QByteArray::number(100000 + i * 500, 8) + "\r\n";
+    }
+    return stream;
+}
+
+// as MountController::read() and ParsePosition() did, without their qDebug()
+static qint64 OldPath(const QByteArray &stream, int *parsed)
+{
+    qint64 sum = 0;
+    QByteArray buffer;
+    for (int pos = 0; pos < stream.size(); pos += read_chunk)
+    {
+        buffer.append(stream.mid(pos, read_chunk));
+        int end;
+        while ((end = buffer.indexOf('\n')) >= 0)
+        {
+            QString line = QString::fromLatin1(buffer.left(end + 1));
+            buffer.remove(0, end + 1);
+            line.replace("\r", "");
+            line.replace("\n", "");
+            if (line.length() == 0 || line[0] == ':')
+                continue;
+            QStringList items = line.split(" ");
+            sum += items[0].toInt(nullptr, 8) + items[1].toInt(nullptr, 8) + items[2].toInt(nullptr, 8);
+            (*parsed)++;
+        }
+    }
+    return sum;
+}
+
+static qint64 RingPath(const QByteArray &stream, int *parsed)
+{
+    qint64 sum = 0;
+    ReplyReader reader;
+    for (int pos = 0; pos < stream.size(); pos += read_chunk)
+    {
+        int len = qMin(read_chunk, stream.size() - pos);
+        int space;
+        char *dst = reader.WriteSpace(&space);
+        // chunk may not fit before the end of the ring
+        int first = qMin(len, space);
+        memcpy(dst, stream.constData() + pos, first);
+        reader.Commit(first);
+        if (first < len)
+        {
+            dst = reader.WriteSpace(&space);
+            memcpy(dst, stream.constData() + pos + first, len - first);
+            reader.Commit(len - first);
+        }
+
+        const char *line;
+        int n;
+        while (reader.NextLine(&line, &n))
+        {
+            int fields[4];
+            if (ParseOctalFields(line, n, fields, 4) >= 3)
+            {
+                sum += fields[0] + fields[1] + fields[2];
+                (*parsed)++;
+            }
+        }
+    }
+    return sum;
+}
+
+QString BenchParser(int replies)
+{
+    QByteArray stream = ReplyStream(replies);
+    QElapsedTimer timer;
+
+    int old_parsed = 0;
+    timer.start();
+    qint64 old_sum = OldPath(stream, &old_parsed);
+    double old_ns = (double)timer.nsecsElapsed() / replies;
+
+    int ring_parsed = 0;
+    timer.start();
+    qint64 ring_sum = RingPath(stream, &ring_parsed);
+    double ring_ns = (double)timer.nsecsElapsed() / replies;
+
+    QString report = QString("parser: %1 replies, QString/split %2 ns, ring %3 ns per reply, %4x")
+                     .arg(replies)
+                     .arg(old_ns, 0, 'f', 1)
+                     .arg(ring_ns, 0, 'f', 1)
+                     .arg(old_ns / ring_ns, 0, 'f', 1);
+    if (old_sum != ring_sum || old_parsed != replies || ring_parsed != replies)
+        report += ", RESULTS DIFFER";
+    return report;
+}
+
+// as CoordinateSystem::LocalSidericTime() did, polynomial from 2000 on every call
+static double OldLST(const QDateTime &datetime, double longitude)
+{
+    static const QDateTime datetime2000(QDate(2000, 1, 1), QTime(0, 0, 0, 0), QTimeZone::utc());
+    double delta = (datetime.toSecsSinceEpoch() - datetime2000.toSecsSinceEpoch()) / 86400.0;
+    const double L0 = 99.967794687;
+    const double L1 = 360.98564736628603;
+    const double L2 = 2.907879e-13;
+    const double L3 = -5.302e-22;
+    double angle = L0 + L1 * delta + L2 * delta*delta + L3 * delta*delta*delta;
+    double total_lst = angle * 24/360 + longitude * 24/360;
+    return total_lst - floor(total_lst / 24) * 24;
+}
+
+QString BenchSidereal(int calls, double longitude)
+{
+    // whole UTC second, old code drops the fraction
+    int64_t start = Timebase::FromUTC(Timebase::ToUTC(Timebase::Now()) / 1000000000 * 1000000000);
+    SiderealClock clock(longitude);
+    clock.Anchor(start);
+
+    // a day of one second steps, repeated
+    QVector<QDateTime> datetimes(calls);
+    QVector<int64_t> times(calls);
+    for (int i = 0; i < calls; i++)
+    {
+        times[i] = start + (int64_t)(i % 86400) * 1000000000;
+        datetimes[i] = QDateTime::fromMSecsSinceEpoch(Timebase::ToUTC(times[i]) / 1000000, QTimeZone::utc());
+    }
+    QVector<double> old_lst(calls), new_lst(calls), batch_lst(calls);
+    QElapsedTimer timer;
+
+    timer.start();
+    for (int i = 0; i < calls; i++)
+        old_lst[i] = OldLST(datetimes[i], longitude);
+    double old_ns = (double)timer.nsecsElapsed() / calls;
+
+    timer.start();
+    for (int i = 0; i < calls; i++)
+        new_lst[i] = clock.LST(times[i]);
+    double clock_ns = (double)timer.nsecsElapsed() / calls;
+
+    timer.start();
+    clock.LST(times.constData(), batch_lst.data(), calls);
+    double batch_ns = (double)timer.nsecsElapsed() / calls;
+
+    // current time as callers get it, old ones asked QDateTime
+    double sum = 0;
+    timer.start();
+    for (int i = 0; i < calls; i++)
+        sum += OldLST(QDateTime::currentDateTimeUtc(), longitude);
+    double old_now_ns = (double)timer.nsecsElapsed() / calls;
+
+    timer.start();
+    for (int i = 0; i < calls; i++)
+        sum += clock.Now();
+    double clock_now_ns = (double)timer.nsecsElapsed() / calls;
+
+    // arcsec, across 0h wrap too
+    double diff = 0;
+    bool same = true;
+    for (int i = 0; i < calls; i++)
+    {
+        double d = fabs(old_lst[i] - new_lst[i]);
+        diff = qMax(diff, qMin(d, 24 - d) * 54000);
+        same = same && batch_lst[i] == new_lst[i];
+    }
+
+    QString report = QString("sidereal: %1 calls, QDateTime polynomial %2 ns, clock %3 ns, batch %4 ns per time, %5x; "
+                             "now %6 ns vs %7 ns; max difference %8\"")
+                     .arg(calls)
+                     .arg(old_ns, 0, 'f', 1)
+                     .arg(clock_ns, 0, 'f', 1)
+                     .arg(batch_ns, 0, 'f', 1)
+                     .arg(old_ns / clock_ns, 0, 'f', 1)
+                     .arg(old_now_ns, 0, 'f', 1)
+                     .arg(clock_now_ns, 0, 'f', 1)
+                     .arg(diff, 0, 'g', 2);
+    if (diff > 1e-3 || !same || std::isnan(sum))
+        report += ", RESULTS DIFFER";
+    return report;
+}
@@ -0,0 +1,16 @@
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+
+#include <QString>
+
+/*
+ * Micro benchmarks of hot paths against the code they replaced.
+ * Each returns report lines, costs are per call in nanoseconds.
+ */
+
+// Reply line parsing: ReplyReader ring against QString and split()
+QString BenchParser(int replies);
+// LocalSidericTime(QDateTime) as it was against SiderealClock
+QString BenchSidereal(int calls, double longitude);
+
+#endif // BENCHMARKS_H
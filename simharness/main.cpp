@@ -0,0 +1,238 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QTimeZone>
+#include <QDebug>
+#include <QtMath>
+#include "clock.h"
+#include "timebase.h"
+#include "mountsimulator.h"
+#include "mountsystem.h"
+#include "simulatedmount.h"
+#include "benchmarks.h"
+#include "scenario.h"
+#include "portrun.h"
+#include "baudrun.h"
+
+/*
+ * Tracker and MountSystem against simulated firmware on a virtual clock.
+ * Every scenario ends tracking an RA/Dec object, errors are the distance
+ * on sky between where the axes are and where the object is.
+ *
+ * With --port the same scenarios run in real time against a live mount.
+ * Baud scenarios run in real time against the simulator on a terminal.
+ */
+
+static const qint64 sim_step = 10000;       // usec
+static const qint64 sample_step = 100000;
+static const qint64 lookahead_step = 50000;
+static const double period_dt = 0.5;
+
+static Result Run(const Scenario &scenario, const Options &options)
+{
+    VirtualClock clock(Timebase::Now());
+    Timebase::SetClock(&clock);
+
+    Config cfg;
+    cfg.lookahead = options.lookahead;
+    cfg.lookahead_thread = false;
+    CoordinateSystem cs(QTimeZone::utc(), options.longitude, options.latitude);
+    MountSimulator sim(options.queue_size, true);
+    SimulatedMount mount(&sim, options.queue_size);
+    PointingModel model(options.latitude);
+    Tracker tracker(&cs, &mount, &cfg);
+    MountSystem system(&mount, &cs, &tracker, &model, &cfg);
+
+    StartScenario(scenario, &system, &cs);
+
+    Result result = EmptyResult();
+    QElapsedTimer wall;
+    wall.start();
+    int queued = 0;
+    qint64 duration = qRound64(options.duration * 1e6);
+    qint64 goto_time = qRound64(scenario.goto_after * 1e6);
+    qint64 origin = 0;
+    qint64 next_tick = 0;
+    for (qint64 t = 0; t <= duration; t += sim_step)
+    {
+        if (goto_time > 0 && t == goto_time)
+        {
+            GotoScenario(scenario, &system, &cs);
+            result = EmptyResult();
+            origin = t;
+        }
+        if (t >= next_tick)
+        {
+            // as control loop does, faster when mount system asks
+            double rate = system.ControlRate();
+            double dt = rate > 0 ? 1 / rate : period_dt;
+            system.ReadPosition();
+            system.TrackingPeriodic(dt);
+            QCoreApplication::processEvents();
+            next_tick = t + qRound64(dt * 1e6);
+        }
+        if (t % lookahead_step == 0)
+            system.ProcessLookahead();
+        if (t % sample_step == 0)
+        {
+            auto expected = tracker.TargetAt(Timebase::Now());
+            auto pos = sim.Position();
+            double ex = std::get<1>(pos) - std::get<0>(expected) / 24 * cfg.x_steps;
+            ex -= qRound(ex / cfg.x_steps) * (double)cfg.x_steps;
+            double ey = std::get<2>(pos) - (std::get<1>(expected) / 360 * cfg.y_steps + cfg.y_steps / 2);
+            double error = hypot(ex * 1296000.0 / cfg.x_steps * cos(std::get<1>(expected) * M_PI / 180),
+                                 ey * 1296000.0 / cfg.y_steps);
+            AddSample(&result, (t - origin) / 1e6, error);
+        }
+
+        // queue drained while there was something to follow
+        int length = sim.QueueLength();
+        if (queued > 0 && length == 0 && result.settle >= 0)
+            result.underruns++;
+        queued = length;
+
+        sim.Advance(sim_step);
+        clock.Advance(sim_step * 1000);
+    }
+
+    result.wall = wall.elapsed() / 1000.0;
+    Finish(&result);
+    result.segments = mount.Segments();
+    result.rejected = mount.Rejected();
+    Timebase::SetClock(nullptr);
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("simharness");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Tracking scenarios against simulated mount in virtual time");
+    parser.addHelpOption();
+    QCommandLineOption scenarioOption("scenario", "Run only this scenario.", "name");
+    QCommandLineOption durationOption("duration", "Simulated time of every scenario, s.", "s", "3600");
+    QCommandLineOption lookaheadOption("lookahead", "Lookahead horizon, s, 0 tracks on every position reply.", "s", "10");
+    QCommandLineOption queueOption("queue-size", "Motion queue depth.", "lines", "2");
+    QCommandLineOption latitudeOption("latitude", "Observer latitude, degrees.", "deg", "55.75");
+    QCommandLineOption longitudeOption("longitude", "Observer longitude, degrees.", "deg", "37.6");
+    QCommandLineOption portOption("port", "Run scenarios in real time against mount on this port.", "device");
+    QCommandLineOption baudOption("baud", "Baud rate negotiated with mount on --port.", "rate", "9600");
+    QCommandLineOption benchOption("bench", "Run micro benchmark instead of scenarios: parser, sidereal.", "name");
+    parser.addOption(scenarioOption);
+    parser.addOption(durationOption);
+    parser.addOption(lookaheadOption);
+    parser.addOption(queueOption);
+    parser.addOption(latitudeOption);
+    parser.addOption(longitudeOption);
+    parser.addOption(portOption);
+    parser.addOption(baudOption);
+    parser.addOption(benchOption);
+    parser.process(a);
+
+    if (parser.isSet(benchOption))
+    {
+        QString bench = parser.value(benchOption);
+        if (bench == "parser")
+            qInfo().noquote() << BenchParser(1000000);
+        else if (bench == "sidereal")
+            qInfo().noquote() << BenchSidereal(1000000, parser.value(longitudeOption).toDouble());
+        else
+        {
+            qCritical() << "Unknown benchmark" << bench;
+            return 1;
+        }
+        return 0;
+    }
+
+    Options options;
+    options.duration = parser.value(durationOption).toDouble();
+    options.lookahead = parser.value(lookaheadOption).toDouble();
+    options.queue_size = parser.value(queueOption).toInt();
+    options.latitude = parser.value(latitudeOption).toDouble();
+    options.longitude = parser.value(longitudeOption).toDouble();
+
+    bool found = false;
+    for (int i = 0; i < scenario_count; i++)
+    {
+        const Scenario &scenario = scenarios[i];
+        if (parser.isSet(scenarioOption) && parser.value(scenarioOption) != scenario.name)
+            continue;
+        found = true;
+        if (parser.isSet(portOption))
+        {
+            PortResult p;
+            QString error;
+            if (!RunOnPort(scenario, options, parser.value(portOption), parser.value(baudOption).toInt(), &p, &error))
+            {
+                qCritical().noquote() << scenario.name + QString(": ") + error;
+                return 1;
+            }
+            QString settle = p.result.settle >= 0 ? QString::number(p.result.settle, 'f', 1) + "s" : "never";
+            qInfo().noquote() << QString("%1: %2s on port, settled %3, rms %4\" peak %5\" final %6\", "
+                                         "positions %7/s segments %8/s, sent %9 B/s received %10 B/s, "
+                                         "position p50 %11us p99 %12us%13")
+                                 .arg(scenario.name)
+                                 .arg(p.result.wall, 0, 'f', 1)
+                                 .arg(settle)
+                                 .arg(p.result.rms, 0, 'f', 1)
+                                 .arg(p.result.peak, 0, 'f', 1)
+                                 .arg(p.result.last, 0, 'f', 1)
+                                 .arg(p.position_rate, 0, 'f', 1)
+                                 .arg(p.goto_rate, 0, 'f', 2)
+                                 .arg(p.sent, 0, 'f', 0)
+                                 .arg(p.received, 0, 'f', 0)
+                                 .arg(p.position_p50)
+                                 .arg(p.position_p99)
+                                 .arg(p.lost ? ", POSITION LOST" : "");
+            continue;
+        }
+        Result r = Run(scenario, options);
+        QString settle = r.settle >= 0 ? QString::number(r.settle, 'f', 1) + "s" : "never";
+        qInfo().noquote() << QString("%1: %2s simulated in %3s, settled %4, rms %5\" peak %6\" final %7\", "
+                                     "segments %8 rejected %9, underruns %10")
+                             .arg(scenario.name)
+                             .arg(options.duration)
+                             .arg(r.wall, 0, 'f', 2)
+                             .arg(settle)
+                             .arg(r.rms, 0, 'f', 1)
+                             .arg(r.peak, 0, 'f', 1)
+                             .arg(r.last, 0, 'f', 1)
+                             .arg(r.segments)
+                             .arg(r.rejected)
+                             .arg(r.underruns);
+    }
+    for (int i = 0; i < baud_scenario_count && !parser.isSet(portOption); i++)
+    {
+        const BaudScenario &scenario = baud_scenarios[i];
+        if (parser.isSet(scenarioOption) && parser.value(scenarioOption) != scenario.name)
+            continue;
+        found = true;
+        BaudResult r;
+        QString error;
+        if (!RunBaud(scenario, &r, &error))
+        {
+            qCritical().noquote() << scenario.name + QString(": ") + error;
+            return 1;
+        }
+        int expected = scenario.switched ? scenario.rate : 9600;
+        bool ok = r.negotiated == scenario.switched && r.link_rate == expected &&
+                  r.firmware_rate == expected && r.position;
+        qInfo().noquote() << QString("%1: %2 baud %3 in %4s, link %5 firmware %6, position %7%8")
+                             .arg(scenario.name)
+                             .arg(scenario.rate)
+                             .arg(r.negotiated ? "negotiated" : "refused")
+                             .arg(r.seconds, 0, 'f', 2)
+                             .arg(r.link_rate)
+                             .arg(r.firmware_rate)
+                             .arg(r.position ? "ok" : "lost")
+                             .arg(ok ? "" : ", UNEXPECTED");
+    }
+    if (!found)
+    {
+        qCritical() << "Unknown scenario" << parser.value(scenarioOption);
+        return 1;
+    }
+    return 0;
+}
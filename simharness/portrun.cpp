@@ -0,0 +1,110 @@
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QTimer>
+#include <QTimeZone>
+#include <QtMath>
+#include "portrun.h"
+#include "mount.h"
+
+static const int sample_interval = 100;     // msec
+
+// arcsec between two points, a as hours, b as degrees
+static double Distance(double a1, double b1, double a2, double b2)
+{
+    double da = fmod(a1 - a2, 24);
+    if (da > 12)
+        da -= 24;
+    else if (da < -12)
+        da += 24;
+    return hypot(da * 54000 * cos(b2 * M_PI / 180), (b1 - b2) * 3600);
+}
+
+bool RunOnPort(const Scenario &scenario, const Options &options, const QString &port,
+               int baudrate, PortResult *result, QString *error)
+{
+    Config cfg;
+    cfg.lookahead = options.lookahead;
+    cfg.queue_size = options.queue_size;
+    Mount mount(cfg);
+    // own pointing model group, the one of GUI is left alone
+    mount.SetName("simharness");
+    if (!mount.Open(port, baudrate, QTimeZone::utc(), options.longitude, options.latitude, error))
+        return false;
+    MountSystem *system = mount.System();
+    MountController *ctl = mount.Controller();
+    CoordinateSystem cs(QTimeZone::utc(), options.longitude, options.latitude);
+    StartScenario(scenario, system, &cs);
+
+    quint64 positions = ctl->RoundTrip(MountCommandPosition).Count();
+    quint64 gotos = ctl->RoundTrip(MountCommandGoto).Count();
+    quint64 sent = ctl->BytesSent();
+    quint64 received = ctl->BytesReceived();
+
+    result->result = EmptyResult();
+    result->lost = false;
+    bool goto_pending = scenario.goto_after > 0;
+    double origin = 0;
+    QElapsedTimer wall;
+    wall.start();
+    QEventLoop events;
+    QTimer sampler;
+    QObject::connect(&sampler, &QTimer::timeout, [&]() {
+        double t = wall.elapsed() / 1000.0;
+        if (t >= options.duration)
+        {
+            events.quit();
+            return;
+        }
+        if (goto_pending && t >= scenario.goto_after)
+        {
+            GotoScenario(scenario, system, &cs);
+            result->result = EmptyResult();
+            goto_pending = false;
+            origin = t;
+        }
+        auto target = system->CurrentTarget();
+        double a = std::get<1>(target);
+        double b = std::get<2>(target);
+        std::tuple<double, double> pos;
+        switch (std::get<0>(target))
+        {
+        case TrackerHoldRADec:
+            pos = system->CurrentPosition_RA_Dec();
+            break;
+        case TrackerHoldAzAlt:
+            // azimuth as hours, same wrap
+            pos = system->CurrentPosition_Az_Alt();
+            a /= 15;
+            std::get<0>(pos) /= 15;
+            break;
+        case TrackerHoldNone:
+            return;
+        default:
+            pos = system->CurrentPosition_HA_Dec();
+            break;
+        }
+        AddSample(&result->result, t - origin, Distance(std::get<0>(pos), std::get<1>(pos), a, b));
+    });
+    QObject::connect(&mount, &Mount::positionLost, &events, [&]() {
+        result->lost = true;
+        events.quit();
+    }, Qt::QueuedConnection);
+    sampler.start(sample_interval);
+    events.exec();
+    sampler.stop();
+
+    double wall_time = wall.elapsed() / 1000.0;
+    Finish(&result->result);
+    result->result.wall = wall_time;
+    result->result.segments = ctl->RoundTrip(MountCommandGoto).Count() - gotos;
+    result->result.rejected = 0;
+    result->result.underruns = 0;
+    result->position_rate = (ctl->RoundTrip(MountCommandPosition).Count() - positions) / wall_time;
+    result->goto_rate = result->result.segments / wall_time;
+    result->sent = (ctl->BytesSent() - sent) / wall_time;
+    result->received = (ctl->BytesReceived() - received) / wall_time;
+    result->position_p50 = ctl->RoundTrip(MountCommandPosition).Percentile(50);
+    result->position_p99 = ctl->RoundTrip(MountCommandPosition).Percentile(99);
+    mount.Close();
+    return true;
+}
@@ -0,0 +1,28 @@
+#ifndef PORTRUN_H
+#define PORTRUN_H
+
+#include <QString>
+#include "scenario.h"
+
+/*
+ * Scenario against a live mount, mountsim PTY or hardware, in real time.
+ * Errors are the distance between reported position and the target,
+ * so they show tracking, not the pointing model.
+ */
+
+struct PortResult
+{
+    Result result;
+    double position_rate;   // position replies per second
+    double goto_rate;       // motion segments per second
+    double sent;            // bytes per second
+    double received;
+    quint64 position_p50;   // usec
+    quint64 position_p99;
+    bool lost;
+};
+
+bool RunOnPort(const Scenario &scenario, const Options &options, const QString &port,
+               int baudrate, PortResult *result, QString *error);
+
+#endif // PORTRUN_H
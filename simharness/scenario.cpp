@@ -0,0 +1,81 @@
+#include <QtMath>
+#include "scenario.h"
+#include "timebase.h"
+
+const Scenario scenarios[] = {
+    {"track-equator", -0.5,  0, -0.5,  0, false, false,  0},
+    {"track-pole",    -0.5, 85, -0.5, 85, false, false,  0},
+    {"goto-short",     0,   20, -0.3, 25, true,  false,  0},
+    {"goto-long",      3,    0, -3,   60, true,  false,  0},
+    {"goto-tracking", -0.5, 20,  1,   40, true,  false, 60},
+    {"satellite",      0,   20,  0,    0, true,  true,   0},
+};
+
+const int scenario_count = sizeof(scenarios) / sizeof(scenarios[0]);
+
+Result EmptyResult()
+{
+    Result result = {0, -1, 0, 0, 0, 0, 0, 0, 0, 0};
+    return result;
+}
+
+void AddSample(Result *result, double t, double error)
+{
+    if (result->settle < 0 && error < settle_error)
+        result->settle = t;
+    if (result->settle < 0)
+        return;
+    result->sum += error * error;
+    result->samples++;
+    result->peak = qMax(result->peak, error);
+    result->last = error;
+}
+
+void Finish(Result *result)
+{
+    result->rms = result->samples > 0 ? sqrt(result->sum / result->samples) : 0;
+}
+
+void StartScenario(const Scenario &scenario, MountSystem *system, CoordinateSystem *cs)
+{
+    auto target = cs->Convert_HADec2RADec(scenario.target_ha, scenario.target_dec, Timebase::Now());
+    double ra = std::get<0>(target);
+    double dec = std::get<1>(target);
+    if (scenario.satellite)
+    {
+        // ISS like orbit
+        TwoLineElements tle;
+        tle.name = "SIM";
+        tle.catalog = 99999;
+        tle.epoch = Timebase::ToUTC(Timebase::Now());
+        tle.bstar = 3e-5;
+        tle.inclination = 51.64;
+        tle.raan = 120;
+        tle.eccentricity = 0.0005;
+        tle.argument_of_perigee = 90;
+        tle.mean_anomaly = 0;
+        tle.mean_motion = 15.5;
+        system->SetPosition_HA_Dec(scenario.start_ha, scenario.start_dec);
+        system->GotoSatellite(tle);
+    }
+    else if (scenario.goto_after > 0)
+    {
+        auto start = cs->Convert_HADec2RADec(scenario.start_ha, scenario.start_dec, Timebase::Now());
+        system->SetPosition_RA_Dec(std::get<0>(start), std::get<1>(start));
+    }
+    else if (scenario.slew)
+    {
+        system->SetPosition_HA_Dec(scenario.start_ha, scenario.start_dec);
+        system->GotoPosition_RA_Dec(ra, dec);
+    }
+    else
+    {
+        system->SetPosition_RA_Dec(ra, dec);
+    }
+}
+
+void GotoScenario(const Scenario &scenario, MountSystem *system, CoordinateSystem *cs)
+{
+    auto target = cs->Convert_HADec2RADec(scenario.target_ha, scenario.target_dec, Timebase::Now());
+    system->GotoPosition_RA_Dec(std::get<0>(target), std::get<1>(target));
+}
@@ -0,0 +1,65 @@
+#ifndef SCENARIO_H
+#define SCENARIO_H
+
+#include <QString>
+#include "coordinatesystem.h"
+#include "mountsystem.h"
+
+struct Scenario
+{
+    const char *name;
+    // mount is set to start HA/Dec, then goes to target given as HA/Dec at start
+    double start_ha;
+    double start_dec;
+    double target_ha;
+    double target_dec;
+    bool slew;
+    // target is a LEO satellite, elements made up at start time
+    bool satellite;
+    // tracks start first and goes to target after this many seconds,
+    // with motion queue full; errors are counted from the goto on
+    double goto_after;
+};
+
+extern const Scenario scenarios[];
+extern const int scenario_count;
+
+struct Options
+{
+    double duration;
+    double lookahead;
+    int queue_size;
+    double latitude;
+    double longitude;
+};
+
+struct Result
+{
+    double wall;
+    double settle;
+    double rms;
+    double peak;
+    // error at the end of run, grows when segments lose steps or time
+    double last;
+    quint64 segments;
+    quint64 rejected;
+    int underruns;
+    // squared errors after settling
+    double sum;
+    int samples;
+};
+
+// settled once the error is below, arcsec
+static const double settle_error = 30;
+
+Result EmptyResult();
+// Error in arcsec at t seconds from start
+void AddSample(Result *result, double t, double error);
+void Finish(Result *result);
+
+// Puts the mount at the start and sends it after the target, at Timebase::Now()
+void StartScenario(const Scenario &scenario, MountSystem *system, CoordinateSystem *cs);
+// Goto to the target of goto_after scenario
+void GotoScenario(const Scenario &scenario, MountSystem *system, CoordinateSystem *cs);
+
+#endif // SCENARIO_H
@@ -0,0 +1,32 @@
+QT       += core
+QT       -= gui
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = simharness
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+include(../core/core.pri)
+
+INCLUDEPATH += ../mountsim
+
+SOURCES += \
+    ../mountsimulator.cpp \
+    ../mountsim/ptysimulator.cpp \
+    baudrun.cpp \
+    benchmarks.cpp \
+    main.cpp \
+    portrun.cpp \
+    scenario.cpp \
+    simulatedmount.cpp
+
+HEADERS += \
+    ../mountsimulator.h \
+    ../mountsim/ptysimulator.h \
+    baudrun.h \
+    benchmarks.h \
+    portrun.h \
+    scenario.h \
+    simulatedmount.h
@@ -0,0 +1,97 @@
+#include "simulatedmount.h"
+#include "timebase.h"
+
+SimulatedMount::SimulatedMount(MountSimulator *sim, int queue_size)
+{
+    this->sim = sim;
+    this->queue_size = queue_size;
+    seq = 0;
+    segments = 0;
+    rejected = 0;
+
+    // switch firmware to frames
+    sim->Receive("V\n");
+    sim->TakeOutput();
+}
+
+MountFrame SimulatedMount::Exchange(uint8_t command, uint8_t seq, int a, int b, int c)
+{
+    MountFrame frame;
+    frame.command = command;
+    frame.seq = seq;
+    frame.a = a;
+    frame.b = b;
+    frame.c = c;
+    uint8_t buf[mount_frame_size];
+    MountFrameEncode(frame, buf);
+    sim->Receive(QByteArray((const char *)buf, mount_frame_size));
+
+    QByteArray reply = sim->TakeOutput();
+    MountFrame result = {0, 0, 0, 0, 0};
+    bool valid = false;
+    MountFrameDecode((const uint8_t *)reply.constData(), reply.length(), &result, &valid);
+    return result;
+}
+
+std::tuple<bool, int, int> SimulatedMount::ReadPosition()
+{
+    MountFrame r = Exchange('P', ++seq & 0xFF, 0, 0, 0);
+    return std::make_tuple(r.command == 'P', r.b, r.c);
+}
+
+std::tuple<bool, int, int, qint64> SimulatedMount::ReadPositionTimed()
+{
+    MountFrame r = Exchange('P', ++seq & 0xFF, 0, 0, 0);
+    return std::make_tuple(r.command == 'P', r.b, r.c, (qint64)HostMonotonicTime());
+}
+
+void SimulatedMount::DisableSteppers()
+{
+    periods.Reset();
+    tids.Disable();
+    Exchange('D', ++seq & 0xFF, 0, 0, 0);
+}
+
+void SimulatedMount::SetPosition(int x, int y)
+{
+    periods.Reset();
+    Exchange('S', ++seq & 0xFF, x, y, 0);
+}
+
+int SimulatedMount::FreeQueueLines()
+{
+    MountFrame r = Exchange('P', ++seq & 0xFF, 0, 0, 0);
+    if (r.command != 'P')
+        return 0;
+    // controller time is above tid
+    return tids.Free(r.a & 0xFF, queue_size);
+}
+
+int SimulatedMount::RequestGoto(int dx, int dy, int time)
+{
+    int tid = tids.Next();
+    MountFrame r = Exchange('G', tid, dx, dy, periods.Period(dx, dy, time));
+    if (r.a == tid)
+        segments++;
+    else
+        rejected++;
+    return tid;
+}
+
+QVector<int> SimulatedMount::RequestGotoBatch(const QVector<MountSegment> &segments)
+{
+    QVector<int> tags;
+    for (const MountSegment &segment : segments)
+        tags.append(RequestGoto(segment.dx, segment.dy, segment.time));
+    return tags;
+}
+
+quint64 SimulatedMount::Segments()
+{
+    return segments;
+}
+
+quint64 SimulatedMount::Rejected()
+{
+    return rejected;
+}
@@ -0,0 +1,43 @@
+#ifndef SIMULATEDMOUNT_H
+#define SIMULATEDMOUNT_H
+
+#include "mountdevice.h"
+#include "mountsimulator.h"
+
+/*
+ * MountDevice on top of in-process MountSimulator.
+ *
+ * Frames go straight to the simulator and replies are taken at once,
+ * no link latency. Time is virtual, caller advances the simulator and
+ * Timebase clock together. Queue space comes from the tid reported by
+ * P, as MountController has it.
+ */
+class SimulatedMount : public MountDevice
+{
+private:
+    MountSimulator *sim;
+    int seq;
+    SegmentTids tids;
+    int queue_size;
+    SegmentPeriods periods;
+    quint64 segments;
+    quint64 rejected;
+private:
+    MountFrame Exchange(uint8_t command, uint8_t seq, int a, int b, int c);
+public:
+    SimulatedMount(MountSimulator *sim, int queue_size);
+
+    std::tuple<bool, int, int> ReadPosition() override;
+    std::tuple<bool, int, int, qint64> ReadPositionTimed() override;
+    void DisableSteppers() override;
+    void SetPosition(int x, int y) override;
+    int FreeQueueLines() override;
+    int RequestGoto(int dx, int dy, int time) override;
+    QVector<int> RequestGotoBatch(const QVector<MountSegment> &segments) override;
+
+    // segments accepted and refused by firmware for full queue
+    quint64 Segments();
+    quint64 Rejected();
+};
+
+#endif // SIMULATEDMOUNT_H
@@ -0,0 +1,78 @@
+#include <QtMath>
+#include "slewplanner.h"
+
+SlewPlanner::SlewPlanner(double max_speed_x, double acceleration_x, double max_speed_y, double acceleration_y,
+                         double min_step)
+{
+    this->max_speed_x = max_speed_x;
+    this->acceleration_x = acceleration_x;
+    this->max_speed_y = max_speed_y;
+    this->acceleration_y = acceleration_y;
+    this->min_step = min_step > 0 ? min_step : default_min_step;
+}
+
+// limits of the path parameter s = 0..1
+void SlewPlanner::Profile(double dx, double dy, double *speed, double *acceleration)
+{
+    double v = INFINITY, a = INFINITY;
+    if (dx != 0)
+    {
+        v = qMin(v, max_speed_x / fabs(dx));
+        a = qMin(a, acceleration_x / fabs(dx));
+    }
+    if (dy != 0)
+    {
+        v = qMin(v, max_speed_y / fabs(dy));
+        a = qMin(a, acceleration_y / fabs(dy));
+    }
+    *speed = v;
+    *acceleration = a;
+}
+
+double SlewPlanner::Duration(double dx, double dy)
+{
+    if (dx == 0 && dy == 0)
+        return 0;
+    double v, a;
+    Profile(dx, dy, &v, &a);
+    if (v * v / a < 1)
+        return 1 / v + v / a;
+    // top speed is not reached
+    return 2 * sqrt(1 / a);
+}
+
+QVector<SlewStep> SlewPlanner::Plan(double dx, double dy, double step)
+{
+    QVector<SlewStep> steps;
+    if (dx == 0 && dy == 0)
+        return steps;
+
+    double v, a;
+    Profile(dx, dy, &v, &a);
+    if (v * v / a >= 1)
+        v = sqrt(a);
+    double ta = v / a;
+    double tc = 1 / v - ta;
+    if (tc < 0)
+        tc = 0;
+
+    // first control tick may be well under a millisecond
+    step = qMax(step, min_step);
+
+    // s(t) on acceleration phase is a*t^2/2, deceleration mirrors it
+    int n = qMax(1, (int)ceil(ta / step));
+    double dt = ta / n;
+    double prev = 0;
+    for (int i = 1; i <= n; i++)
+    {
+        double s = a * (i * dt) * (i * dt) / 2;
+        steps.append({(s - prev) * dx, (s - prev) * dy, dt});
+        prev = s;
+    }
+    int accel_steps = steps.size();
+    if (tc > 0)
+        steps.append({(1 - 2 * prev) * dx, (1 - 2 * prev) * dy, tc});
+    for (int i = accel_steps - 1; i >= 0; i--)
+        steps.append(steps[i]);
+    return steps;
+}
@@ -0,0 +1,43 @@
+#ifndef SLEWPLANNER_H
+#define SLEWPLANNER_H
+
+#include <QVector>
+
+struct SlewStep
+{
+    double dx;
+    double dy;
+    double time;
+};
+
+/*
+ * Minimum time trapezoidal slew of two axes along a straight line.
+ *
+ * Both axes follow one normalized velocity profile scaled by their
+ * distance, so they start and arrive together and the limiting axis
+ * runs at its own speed and acceleration limits. Profile is emitted
+ * as constant speed segments: acceleration and deceleration sampled
+ * by step, cruise as a single segment. Step is never shorter than
+ * min_step, a tiny one would flood the queue with segments.
+ */
+class SlewPlanner
+{
+private:
+    // used when no sane min_step is given, s
+    const double default_min_step = 0.01;
+private:
+    double max_speed_x, acceleration_x;
+    double max_speed_y, acceleration_y;
+    double min_step;
+private:
+    void Profile(double dx, double dy, double *speed, double *acceleration);
+public:
+    // units per second and per second^2, shortest segment in seconds
+    SlewPlanner(double max_speed_x, double acceleration_x, double max_speed_y, double acceleration_y,
+                double min_step);
+
+    double Duration(double dx, double dy);
+    QVector<SlewStep> Plan(double dx, double dy, double step);
+};
+
+#endif // SLEWPLANNER_H
@@ -0,0 +1,54 @@
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <atomic>
+
+/*
+ * Lock-free bounded queue for one producer thread and one consumer thread.
+ * Capacity must be a power of two, indexes run freely and wrap around.
+ */
+template <typename T, unsigned N>
+class SpscQueue
+{
+    static_assert(N > 0 && (N & (N - 1)) == 0, "SpscQueue capacity must be a power of two");
+private:
+    T items[N];
+    // next item to read, written only by consumer
+    std::atomic<unsigned> head;
+    // next item to write, written only by producer
+    std::atomic<unsigned> tail;
+public:
+    SpscQueue() : head(0), tail(0) {}
+
+    bool Push(const T &item)
+    {
+        unsigned t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == N)
+            return false;
+        items[t % N] = item;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool Pop(T *item)
+    {
+        unsigned h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire))
+            return false;
+        *item = items[h % N];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool Empty() const
+    {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+
+    unsigned Size() const
+    {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+};
+
+#endif // SPSCQUEUE_H
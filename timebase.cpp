@@ -0,0 +1,66 @@
+#include "timebase.h"
+#include <chrono>
+
+static std::atomic<Clock *> source(nullptr);
+
+static int64_t monotonic()
+{
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+}
+
+Timebase::Timebase()
+{
+    // wall clock read is bracketed by monotonic ones, the tightest pair wins
+    int64_t best = -1;
+    for (int i = 0; i < 5; i++)
+    {
+        int64_t before = monotonic();
+        auto utc = std::chrono::system_clock::now().time_since_epoch();
+        int64_t after = monotonic();
+        if (best < 0 || after - before < best)
+        {
+            best = after - before;
+            anchor_mono = before + (after - before) / 2;
+            anchor_utc = std::chrono::duration_cast<std::chrono::nanoseconds>(utc).count();
+        }
+    }
+}
+
+const Timebase &Timebase::Instance()
+{
+    static Timebase timebase;
+    return timebase;
+}
+
+int64_t Timebase::Now()
+{
+    Clock *clock = source.load(std::memory_order_acquire);
+    if (clock)
+        return clock->Now();
+    return monotonic();
+}
+
+void Timebase::SetClock(Clock *clock)
+{
+    // anchor is taken on the real clock
+    Instance();
+    source.store(clock, std::memory_order_release);
+}
+
+int64_t Timebase::ToUTC(int64_t time)
+{
+    const Timebase &tb = Instance();
+    return time - tb.anchor_mono + tb.anchor_utc;
+}
+
+int64_t Timebase::FromUTC(int64_t utc)
+{
+    const Timebase &tb = Instance();
+    return utc - tb.anchor_utc + tb.anchor_mono;
+}
+
+int64_t HostMonotonicTime()
+{
+    return Timebase::Now() / 1000;
+}
@@ -0,0 +1,37 @@
+#ifndef TIMEBASE_H
+#define TIMEBASE_H
+
+#include <cstdint>
+#include "clock.h"
+
+/*
+ * Host time in nanoseconds on the monotonic clock.
+ *
+ * Anchored to UTC once at first use, so NTP steps of the wall clock
+ * do not move tracking time. All time stamps of tracking, sidereal
+ * clock and position samples are on this base.
+ *
+ * Another clock may be installed for simulation, it should start from
+ * Now() of the monotonic one, so UTC mapping stays valid.
+ */
+class Timebase
+{
+private:
+    int64_t anchor_mono;
+    int64_t anchor_utc;
+private:
+    Timebase();
+    static const Timebase &Instance();
+public:
+    static int64_t Now();
+    // nullptr returns to the monotonic clock
+    static void SetClock(Clock *clock);
+    // UTC nanoseconds since Unix epoch
+    static int64_t ToUTC(int64_t time);
+    static int64_t FromUTC(int64_t utc);
+};
+
+// Host monotonic clock, usec
+int64_t HostMonotonicTime();
+
+#endif // TIMEBASE_H
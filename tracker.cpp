@@ -1,4 +1,6 @@
 #include "tracker.h"
+#include "timebase.h"
+#include <QtMath>
 
 /**
  * Как оно работает:
@@ -15,6 +17,7 @@
  * 1) delta_t - длительность добавляемого отрезка
  *
  * 2) target_ha, target_dec - координаты (target_ra, target_dec) на момент finish_time + delta_t
+ *    с учётом прецессии, нутации, аберрации и рефракции (CoordinateSystem::Convert_RADec2HADec)
  *
  * 3) delta_ha, delta_dec - на сколько надо сдвинуться от point_ha, point_dec, чтобы прийти в target_ha, target_dec
  *
@@ -28,26 +31,52 @@
  *    point_dec   := point_dec + p_delta_dec
  *
  * 3) Выполняем Goto по p_delta_ha, p_delta_dec
+ *
+ * Спутник (TrackerHoldSatellite) задаётся элементами TLE, положение на любой
+ * момент считает SGP4, дальше топоцентрические HA/Dec как для любой цели.
+ * Солнце, Луна и планеты (TrackerHoldBody) так же, только геоцентрическое
+ * положение берётся из эфемерид (Ephemeris) и учитывается параллакс.
+ *
+ * Цель по RA/Dec может смещаться с постоянной скоростью (rate_ra, rate_dec):
+ * Луна, Солнце, кометы. target_ra, target_dec - её положение на rate_epoch.
+ *
+ * При смене цели сначала планируется перелёт (SlewPlanner): трапеция скорости
+ * с ограничением ускорения, обе оси приходят одновременно в точку, где цель
+ * будет к концу перелёта. Пока план не исчерпан, отрезки берутся из него.
  */
 
-Tracker::Tracker(CoordinateSystem *cs, MountController *ctl, Config *cfg)
+Tracker::Tracker(CoordinateSystem *cs, MountDevice *ctl, Config *cfg)
+    : planner(24.0 / cfg->x_rotation_time, 24.0 / cfg->x_rotation_time / cfg->x_acceleration_time,
+              360.0 / cfg->y_rotation_time, 360.0 / cfg->y_rotation_time / cfg->y_acceleration_time,
+              cfg->satellite_segment_time)
 {
     mode = TrackerHoldNone;
     this->cs = cs;
     this->ctl = ctl;
     this->cfg = cfg;
-    finish_time = QDateTime::currentDateTime();
+    finish_time = Timebase::Now();
+    replan = false;
+    target_inverted = false;
+    ephemeris = nullptr;
+    body = -1;
+    target_ra = 0;
+    target_dec = 0;
+    rate_ra = 0;
+    rate_dec = 0;
+    rate_epoch = finish_time;
 }
 
 void Tracker::Init_Track_RA_Dec(double ra, double dec)
 {
-    auto time = QDateTime::currentDateTime();
-    double ha = cs->Convert_RA2HA(ra, time);
-    this->point_ha = ha;
-    this->point_dec = dec;
+    auto hadec = cs->Convert_RADec2HADec(ra, dec, Timebase::Now());
+    this->point_ha = std::get<0>(hadec);
+    this->point_dec = std::get<1>(hadec);
     this->target_ra = ra;
     this->target_dec = dec;
+    rate_epoch = Timebase::Now();
     mode = TrackerHoldRADec;
+    slew.clear();
+    replan = false;
 }
 
 void Tracker::Init_Track_HA_Dec(double ha, double dec)
@@ -57,6 +86,8 @@ void Tracker::Init_Track_HA_Dec(double ha, double dec)
     this->target_ha = ha;
     this->target_dec = dec;
     mode = TrackerHoldHADec;
+    slew.clear();
+    replan = false;
 }
 
 void Tracker::Init_Track_Az_Alt(double az, double alt)
@@ -70,75 +101,163 @@ void Tracker::Init_Track_Az_Alt(double az, double alt)
     this->target_az = az;
     this->target_alt = alt;
     mode = TrackerHoldAzAlt;
+    slew.clear();
+    replan = false;
+}
+
+void Tracker::Hold_Point_RA_Dec()
+{
+    auto radec = cs->Convert_HADec2RADec(point_ha, point_dec, finish_time);
+    target_ra = std::get<0>(radec);
+    target_dec = std::get<1>(radec);
+    rate_epoch = finish_time;
+    mode = TrackerHoldRADec;
+    slew.clear();
+    replan = false;
 }
 
 void Tracker::StopTracking()
 {
     mode = TrackerHoldNone;
+    slew.clear();
+    replan = false;
 }
 
 void Tracker::Set_Target_RA_Dec(double ra, double dec)
 {
     target_ra = ra;
     target_dec = dec;
+    rate_epoch = Timebase::Now();
+    replan = true;
 }
 
 void Tracker::Set_Target_HA_Dec(double ha, double dec)
 {
     target_ha = ha;
     target_dec = dec;
+    replan = true;
 }
 
 void Tracker::Set_Target_Az_Alt(double az, double alt)
 {
     target_az = az;
     target_alt = alt;
+    replan = true;
 }
 
-QDateTime Tracker::NextFinishTime(double delta_t)
+bool Tracker::Set_Target_Satellite(const TwoLineElements &tle)
 {
-    QDateTime new_finish_time;
-    if (finish_time < QDateTime::currentDateTime())
-        new_finish_time = QDateTime::currentDateTime().addSecs(delta_t);
-    else
-        new_finish_time = finish_time.addSecs(delta_t);
-    return new_finish_time;
+    SGP4 propagator(tle);
+    if (!propagator.Valid())
+        return false;
+    satellite = propagator;
+    // follow in the form the mount is in now
+    target_inverted = point_dec > 90 || point_dec < -90;
+    mode = TrackerHoldSatellite;
+    replan = true;
+    return true;
 }
 
-std::tuple<double, double> Tracker::Track(double target_ha, double target_dec, QDateTime new_finish_time, double delta_t)
+bool Tracker::Set_Target_Body(const Ephemeris *ephemeris, int body)
 {
-    // вычисляем необходимую дельту для прихода в нужную точку
-    double delta_ha = target_ha - point_ha;
-    double delta_dec = target_dec - point_dec;
+    double r[3];
+    if (!ephemeris->Position(body, Timebase::Now(), r))
+        return false;
+    this->ephemeris = ephemeris;
+    this->body = body;
+    target_inverted = point_dec > 90 || point_dec < -90;
+    mode = TrackerHoldBody;
+    replan = true;
+    return true;
+}
+
+void Tracker::Set_Rate(double dra, double ddec)
+{
+    // target keeps where it is now, moves on at new rate;
+    // other modes only keep rates for next RA/Dec target
+    if (mode == TrackerHoldRADec)
+    {
+        qint64 now = Timebase::Now();
+        auto radec = Drifted_RA_Dec(now);
+        target_ra = std::get<0>(radec);
+        target_dec = std::get<1>(radec);
+        rate_epoch = now;
+    }
+    rate_ra = dra;
+    rate_dec = ddec;
+}
+
+std::tuple<double, double> Tracker::Drifted_RA_Dec(qint64 time)
+{
+    double dt = (time - rate_epoch) / 1e9;
+    double ra = fmod(target_ra + rate_ra * dt, 24);
+    if (ra < 0)
+        ra += 24;
+    return std::make_tuple(ra, target_dec + rate_dec * dt);
+}
+
+std::tuple<double, double> Tracker::Point()
+{
+    return std::make_tuple(point_ha, point_dec);
+}
+
+bool Tracker::Sync(double ha, double dec, qint64 time)
+{
+    // while segments run the planned end point is still ahead,
+    // once they are done next segment starts from the measured point
+    if (mode == TrackerHoldNone || finish_time > time)
+        return false;
+    point_ha = ha;
+    point_dec = dec;
+    finish_time = time;
+    return true;
+}
 
+// duration in usec
+qint64 Tracker::NextFinishTime(qint64 duration)
+{
+    qint64 now = Timebase::Now();
+    if (finish_time < now)
+        return now + duration * 1000;
+    return finish_time + duration * 1000;
+}
+
+static double wrap_ha(double delta_ha)
+{
     if (delta_ha > 12)
         delta_ha = -(24 - delta_ha);
     else if (delta_ha < -12)
         delta_ha = (-24 - delta_ha);
+    return delta_ha;
+}
 
+static double wrap_dec(double delta_dec)
+{
     if (delta_dec > 180)
         delta_dec = -(360 - delta_dec);
     else if (delta_dec < -180)
         delta_dec = -(-360 - delta_dec);
+    return delta_dec;
+}
+
+std::tuple<double, double> Tracker::Track(double target_ha, double target_dec, qint64 new_finish_time, double delta_t)
+{
+    // вычисляем необходимую дельту для прихода в нужную точку
+    double delta_ha = wrap_ha(target_ha - point_ha);
+    double delta_dec = wrap_dec(target_dec - point_dec);
 
     // максимальная дельта за указанное время
     double max_delta_ha = delta_t / cfg->x_rotation_time * 24;
     double max_delta_dec = delta_t / cfg->y_rotation_time * 360;
 
-    // ограничиваем дельту максимальными значениям
-    double p_delta_ha = delta_ha;
-    double p_delta_dec = delta_dec;
-
-    if (abs(p_delta_ha) > max_delta_ha)
-    {
-        p_delta_ha *= max_delta_ha / abs(p_delta_ha);
-        p_delta_dec *= max_delta_ha / abs(p_delta_ha);
-    }
-    if (abs(delta_dec) > max_delta_dec)
-    {
-        p_delta_ha *= max_delta_dec / abs(p_delta_dec);
-        p_delta_dec *= max_delta_dec / abs(p_delta_dec);
-    }
+    // ограничиваем дельту максимальными значениям, сохраняя направление
+    double k = 1;
+    if (fabs(delta_ha) > max_delta_ha)
+        k = max_delta_ha / fabs(delta_ha);
+    if (fabs(delta_dec) * k > max_delta_dec)
+        k = max_delta_dec / fabs(delta_dec);
+    double p_delta_ha = delta_ha * k;
+    double p_delta_dec = delta_dec * k;
 
     // сохраняем сдвинутый конец отрезка
     point_ha = point_ha + p_delta_ha;
@@ -148,24 +267,114 @@ std::tuple<double, double> Tracker::Track(double target_ha, double target_dec, Q
     return std::make_tuple(p_delta_ha, p_delta_dec);
 }
 
-std::tuple<double, double, double> Tracker::Track_RA_Dec(double delta_t, double new_target_ra, double new_target_dec)
+std::tuple<double, double> Tracker::SatelliteAt(qint64 time)
 {
-    QDateTime new_finish_time = NextFinishTime(delta_t);
-    double new_target_ha = cs->Convert_RA2HA(new_target_ra, new_finish_time);
-    std::tuple<double, double> delta = Track(new_target_ha, new_target_dec, new_finish_time, delta_t);
+    double r[3], v[3];
+    // decayed, nothing to follow
+    if (!satellite.At(time, r, v))
+        return std::make_tuple(point_ha, point_dec);
+    auto hadec = cs->Convert_TEME2HADec(r, time);
+    if (target_inverted)
+        return cs->Inverted_HA_Dec_Coordinates(std::get<0>(hadec), std::get<1>(hadec));
+    return hadec;
+}
+
+std::tuple<double, double> Tracker::BodyAt(qint64 time)
+{
+    double r[3];
+    // out of ephemeris time span
+    if (!ephemeris->Position(body, time, r))
+        return std::make_tuple(point_ha, point_dec);
+    auto hadec = cs->Convert_Geocentric2HADec(r, time);
+    if (target_inverted)
+        return cs->Inverted_HA_Dec_Coordinates(std::get<0>(hadec), std::get<1>(hadec));
+    return hadec;
+}
+
+std::tuple<double, double> Tracker::TargetAt(qint64 time)
+{
+    switch(mode)
+    {
+    case TrackerHoldRADec:
+    {
+        auto radec = Drifted_RA_Dec(time);
+        return cs->Convert_RADec2HADec(std::get<0>(radec), std::get<1>(radec), time);
+    }
+    case TrackerHoldHADec:
+        return std::make_tuple(target_ha, target_dec);
+    case TrackerHoldAzAlt:
+        return cs->Convert_from_Az_Alt(target_az, target_alt);
+    case TrackerHoldSatellite:
+        return SatelliteAt(time);
+    case TrackerHoldBody:
+        return BodyAt(time);
+    default:
+        return std::make_tuple(point_ha, point_dec);
+    }
+}
+
+QVector<SlewStep> Tracker::Slew(double ha, double dec, qint64 start, double step)
+{
+    // aim where the target will be on arrival, moving target
+    // shifts duration a little, a few iterations are enough
+    double duration = 0;
+    double dha = 0, ddec = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        auto target = TargetAt(start + qRound64(duration * 1e9));
+        dha = wrap_ha(std::get<0>(target) - ha);
+        ddec = wrap_dec(std::get<1>(target) - dec);
+        duration = planner.Duration(dha, ddec);
+    }
+    return planner.Plan(dha, ddec, step);
+}
+
+void Tracker::PlanSlew(double step)
+{
+    for (const SlewStep &s : Slew(point_ha, point_dec, NextFinishTime(0), step))
+        slew.enqueue(s);
+}
+
+bool Tracker::Tracking()
+{
+    return mode != TrackerHoldNone;
+}
+
+bool Tracker::TrackingSatellite()
+{
+    return mode == TrackerHoldSatellite;
+}
+
+bool Tracker::TakeTargetChanged()
+{
+    bool changed = replan;
+    replan = false;
+    return changed;
+}
+
+std::tuple<double, double, double> Tracker::Track_RA_Dec(qint64 duration)
+{
+    double delta_t = duration / 1e6;
+    qint64 new_finish_time = NextFinishTime(duration);
+    // catalog position to where the mount has to point at segment end
+    std::tuple<double, double> radec = Drifted_RA_Dec(new_finish_time);
+    std::tuple<double, double> hadec = cs->Convert_RADec2HADec(std::get<0>(radec), std::get<1>(radec), new_finish_time);
+    std::tuple<double, double> delta = Track(std::get<0>(hadec), std::get<1>(hadec), new_finish_time, delta_t);
     return std::make_tuple(std::get<0>(delta), std::get<1>(delta), delta_t);
 }
 
-std::tuple<double, double, double> Tracker::Track_HA_Dec(double delta_t, double new_target_ha, double new_target_dec)
+std::tuple<double, double, double> Tracker::Track_HA_Dec(qint64 duration, double new_target_ha, double new_target_dec)
 {
-    QDateTime new_finish_time = NextFinishTime(delta_t);
+    double delta_t = duration / 1e6;
+    qint64 new_finish_time = NextFinishTime(duration);
     std::tuple<double, double> delta = Track(new_target_ha, new_target_dec, new_finish_time, delta_t);
     return std::make_tuple(std::get<0>(delta), std::get<1>(delta), delta_t);
 }
 
-std::tuple<double, double, double> Tracker::Track_Az_Alt(double delta_t, double new_target_az, double new_target_alt)
+std::tuple<double, double, double> Tracker::Track_Az_Alt(qint64 duration, double new_target_az, double new_target_alt)
 {
-    QDateTime new_finish_time = NextFinishTime(delta_t);
+    double delta_t = duration / 1e6;
+    qint64 new_finish_time = NextFinishTime(duration);
     std::tuple<double, double> hadec = cs->Convert_from_Az_Alt(new_target_az, new_target_alt);
     double new_target_ha = std::get<0>(hadec);
     double new_target_dec = std::get<1>(hadec);
@@ -174,18 +383,52 @@ std::tuple<double, double, double> Tracker::Track_Az_Alt(double delta_t, double
     return std::make_tuple(std::get<0>(delta), std::get<1>(delta), delta_t);
 }
 
+// satellite or body
+std::tuple<double, double, double> Tracker::Track_Moving(qint64 duration)
+{
+    double delta_t = duration / 1e6;
+    qint64 new_finish_time = NextFinishTime(duration);
+    auto hadec = TargetAt(new_finish_time);
+    std::tuple<double, double> delta = Track(std::get<0>(hadec), std::get<1>(hadec), new_finish_time, delta_t);
+    return std::make_tuple(std::get<0>(delta), std::get<1>(delta), delta_t);
+}
+
 std::tuple<double, double, double> Tracker::ProcessTrack(double delta_t)
 {
+    if (mode == TrackerHoldNone)
+        return std::make_tuple(0, 0, 0);
+
+    if (replan)
+    {
+        replan = false;
+        slew.clear();
+        PlanSlew(delta_t);
+    }
+    if (!slew.isEmpty())
+    {
+        SlewStep s = slew.dequeue();
+        qint64 duration = qRound64(s.time * 1e6);
+        finish_time = NextFinishTime(duration);
+        point_ha += s.dx;
+        point_dec += s.dy;
+        return std::make_tuple(s.dx, s.dy, duration / 1e6);
+    }
+
     delta_t *= 4;
+    // controller counts segment time in whole usec
+    qint64 duration = qRound64(delta_t * 1e6);
 
     switch(mode)
     {
     case TrackerHoldRADec:
-        return Track_RA_Dec(delta_t, target_ra, target_dec);
+        return Track_RA_Dec(duration);
     case TrackerHoldHADec:
-        return Track_HA_Dec(delta_t, target_ha, target_dec);
+        return Track_HA_Dec(duration, target_ha, target_dec);
     case TrackerHoldAzAlt:
-        return Track_Az_Alt(delta_t, target_az, target_alt);
+        return Track_Az_Alt(duration, target_az, target_alt);
+    case TrackerHoldSatellite:
+    case TrackerHoldBody:
+        return Track_Moving(duration);
     default:
         return std::make_tuple(0, 0, 0);
     }
@@ -193,6 +436,13 @@ std::tuple<double, double, double> Tracker::ProcessTrack(double delta_t)
 
 void Tracker::InvertCoordinates()
 {
+    // planned steps are in the old form
+    if (!slew.isEmpty())
+    {
+        slew.clear();
+        replan = true;
+    }
+
     auto p = cs->Inverted_HA_Dec_Coordinates(point_ha, point_dec);
     point_ha = std::get<0>(p);
     point_dec = std::get<1>(p);
@@ -201,6 +451,11 @@ void Tracker::InvertCoordinates()
     {
     case TrackerHoldRADec:
     {
+        auto radec = Drifted_RA_Dec(finish_time);
+        target_ra = std::get<0>(radec);
+        target_dec = std::get<1>(radec);
+        rate_epoch = finish_time;
+        rate_dec = -rate_dec;
         target_ha = cs->Convert_RA2HA(target_ra, finish_time);
         auto r = cs->Inverted_HA_Dec_Coordinates(target_ha, target_dec);
         target_ra = cs->Convert_HA2RA(std::get<0>(r), finish_time);
@@ -223,6 +478,10 @@ void Tracker::InvertCoordinates()
         target_alt = std::get<1>(m);
         break;
     }
+    case TrackerHoldSatellite:
+    case TrackerHoldBody:
+        target_inverted = !target_inverted;
+        break;
     default:
         break;
     }
@@ -233,9 +492,12 @@ TrackerMode Tracker::Get_Tracking_Target(double *a, double *b)
     switch(mode)
     {
     case TrackerHoldRADec:
-        *a = target_ra;
-        *b = target_dec;
+    {
+        auto radec = Drifted_RA_Dec(Timebase::Now());
+        *a = std::get<0>(radec);
+        *b = std::get<1>(radec);
         break;
+    }
     case TrackerHoldHADec:
         *a = target_ha;
         *b = target_dec;
@@ -244,6 +506,14 @@ TrackerMode Tracker::Get_Tracking_Target(double *a, double *b)
         *a = target_az;
         *b = target_alt;
         break;
+    case TrackerHoldSatellite:
+    case TrackerHoldBody:
+    {
+        auto hadec = TargetAt(Timebase::Now());
+        *a = std::get<0>(hadec);
+        *b = std::get<1>(hadec);
+        break;
+    }
     case TrackerHoldNone:
         break;
     }
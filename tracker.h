@@ -2,8 +2,12 @@
 #define TRACKER_H
 
 #include "coordinatesystem.h"
-#include "mountcontroller.h"
+#include "mountdevice.h"
 #include "config.h"
+#include "slewplanner.h"
+#include "sgp4.h"
+#include "ephemeris.h"
+#include <QQueue>
 
 enum TrackerMode
 {
@@ -11,6 +15,8 @@ enum TrackerMode
     TrackerHoldHADec,
     TrackerHoldRADec,
     TrackerHoldAzAlt,
+    TrackerHoldSatellite,
+    TrackerHoldBody,
 };
 
 class Tracker
@@ -18,7 +24,7 @@ class Tracker
 private:
     TrackerMode mode;
     CoordinateSystem *cs;
-    MountController *ctl;
+    MountDevice *ctl;
     Config *cfg;
 
     double target_ra;
@@ -26,38 +32,81 @@ private:
     double target_dec;
     double target_az;
     double target_alt;
+    // RA/Dec target drift, hours and degrees per second since rate_epoch
+    double rate_ra;
+    double rate_dec;
+    qint64 rate_epoch;
+    SGP4 satellite;
+    const Ephemeris *ephemeris;
+    int body;
+    // satellite or body position is given in the other form (dec > 90)
+    bool target_inverted;
 
     double point_ha;
     double point_dec;
-    QDateTime finish_time;
+    // Timebase nanoseconds
+    qint64 finish_time;
+
+    // planned goto, consumed before tracking segments
+    SlewPlanner planner;
+    QQueue<SlewStep> slew;
+    bool replan;
 public:
-    Tracker(CoordinateSystem *cs, MountController *ctl, Config *cfg);
+    Tracker(CoordinateSystem *cs, MountDevice *ctl, Config *cfg);
 
     // Start tracking and specify current position
     void Init_Track_RA_Dec(double ra, double dec);
     void Init_Track_HA_Dec(double ha, double dec);
     void Init_Track_Az_Alt(double az, double alt);
+    // Holds RA/Dec of the point already sent segments end at, they stay queued
+    void Hold_Point_RA_Dec();
     void StopTracking();
 
     // Set target position
     void Set_Target_RA_Dec(double ra, double dec);
     void Set_Target_HA_Dec(double ha, double dec);
     void Set_Target_Az_Alt(double az, double alt);
+    // Switches to satellite tracking, slews to it first
+    bool Set_Target_Satellite(const TwoLineElements &tle);
+    // Same for Sun, Moon or planet from ephemeris, it must outlive tracking
+    bool Set_Target_Body(const Ephemeris *ephemeris, int body);
+    // RA/Dec target moves at these rates, hours and degrees per second
+    void Set_Rate(double dra, double ddec);
 
     // Show tracking target
     TrackerMode Get_Tracking_Target(double *a, double *b);
 
-    // Should be called by timer
+    // End of already planned segments, HA/Dec
+    std::tuple<double, double> Point();
+
+    bool Tracking();
+    bool TrackingSatellite();
+    // Target HA/Dec at Timebase time
+    std::tuple<double, double> TargetAt(qint64 time);
+    // Target was set since last call, slew is needed
+    bool TakeTargetChanged();
+    // Slew from ha/dec starting at time to the target, steps of HA/Dec
+    QVector<SlewStep> Slew(double ha, double dec, qint64 start, double step);
+
+    // Measured position and its acquisition time, true when tracking goes on from it
+    bool Sync(double ha, double dec, qint64 time);
+
+    // Should be called by timer, segment duration is rounded to usec
     std::tuple<double, double, double> ProcessTrack(double delta_t);
 
     // Invert coordinate system (dec > 90)
     void InvertCoordinates();
 private:
-    std::tuple<double, double> Track(double target_ha, double target_dec, QDateTime new_finish_time, double delta_t);
-    std::tuple<double, double, double> Track_RA_Dec(double delta_t, double new_target_ra, double new_target_dec);
-    std::tuple<double, double, double> Track_HA_Dec(double delta_t, double new_target_ha, double new_target_dec);
-    std::tuple<double, double, double> Track_Az_Alt(double delta_t, double new_target_az, double new_target_alt);
-    QDateTime NextFinishTime(double dt);
+    void PlanSlew(double step);
+    std::tuple<double, double> Track(double target_ha, double target_dec, qint64 new_finish_time, double delta_t);
+    std::tuple<double, double, double> Track_RA_Dec(qint64 duration);
+    std::tuple<double, double, double> Track_HA_Dec(qint64 duration, double new_target_ha, double new_target_dec);
+    std::tuple<double, double, double> Track_Az_Alt(qint64 duration, double new_target_az, double new_target_alt);
+    std::tuple<double, double, double> Track_Moving(qint64 duration);
+    std::tuple<double, double> SatelliteAt(qint64 time);
+    std::tuple<double, double> BodyAt(qint64 time);
+    std::tuple<double, double> Drifted_RA_Dec(qint64 time);
+    qint64 NextFinishTime(qint64 duration);
 };
 
 #endif // TRACKER_H